@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace MemScanner {
+
+	// Relative frequency of every byte value in x86-64 machine code, scaled so that all entries add up to ~65536.
+	// Measured over the .text sections of ~900 x86-64 ELF executables and shared libraries.
+	inline constexpr std::array<uint16_t, 256> x86ByteFrequency = {
+		8320, 1203, 443, 324, 489, 330, 151, 166, 728, 124, 93, 109, 157, 115, 70, 2246,  // 00
+		631, 181, 65, 57, 129, 189, 64, 54, 325, 49, 43, 42, 84, 58, 48, 478,  // 10
+		346, 76, 43, 38, 1930, 130, 34, 38, 300, 185, 37, 73, 74, 58, 138, 42,  // 20
+		226, 419, 34, 46, 77, 122, 34, 45, 194, 342, 43, 106, 119, 136, 42, 57,  // 30
+		450, 995, 83, 158, 879, 350, 89, 116, 4804, 774, 62, 59, 1154, 265, 51, 54,  // 40
+		225, 43, 40, 152, 226, 189, 99, 104, 125, 37, 35, 157, 178, 201, 106, 97,  // 50
+		138, 54, 157, 79, 128, 51, 751, 43, 109, 47, 40, 53, 113, 52, 60, 167,  // 60
+		182, 37, 87, 85, 585, 302, 59, 74, 122, 41, 36, 78, 225, 114, 108, 122,  // 70
+		282, 141, 48, 872, 839, 783, 50, 70, 141, 2600, 42, 1901, 83, 1017, 41, 39,  // 80
+		198, 29, 30, 34, 95, 55, 27, 29, 77, 32, 23, 24, 54, 33, 24, 27,  // 90
+		87, 56, 26, 31, 40, 28, 24, 25, 78, 27, 36, 31, 58, 27, 23, 44,  // A0
+		93, 44, 24, 31, 76, 44, 135, 89, 159, 103, 162, 52, 132, 73, 171, 106,  // B0
+		644, 360, 152, 333, 239, 225, 231, 428, 147, 144, 74, 47, 61, 51, 59, 54,  // C0
+		157, 94, 152, 75, 55, 64, 70, 64, 145, 78, 69, 115, 48, 66, 92, 196,  // D0
+		183, 115, 108, 71, 78, 75, 96, 130, 1111, 453, 98, 268, 133, 125, 131, 219,  // E0
+		170, 76, 113, 155, 61, 129, 244, 187, 238, 133, 150, 142, 147, 258, 462, 3011,  // F0
+	};
+
+	// Offsets of the bytes a scan kernel compares first, sorted from most to least selective
+	struct PatternAnchors {
+		std::array<uint32_t, 3> offsets{};
+		uint32_t count = 0;
+		bool partial = false;  // at least one anchor has a mask other than 0xFF, kernels have to AND before comparing
+
+		// The most selective 8 byte window apart from the anchors (4 bytes for patterns shorter than 8, none below 4 or if it would only
+		// repeat the anchors). Candidates are compared on it with a single load before the rest of the pattern is verified.
+		// filterBytes and filterMask are little endian, filterBytes is already ANDed with the mask
+		uint32_t filterOffset = 0, filterSize = 0;
+		uint64_t filterBytes = 0, filterMask = 0;
+	};
+
+	// Combined frequency of all byte values v with (v & mask) == (byte & mask)
+	constexpr uint32_t MaskedByteFrequency(uint8_t byte, uint8_t mask) {
+		if (mask == 0xFF) return x86ByteFrequency[byte];
+		uint32_t frequency = 0;
+		for (unsigned int v = 0; v < 256; v++)
+			if (((v ^ byte) & mask) == 0) frequency += x86ByteFrequency[v];
+		return frequency;
+	}
+
+	// Roughly the bits of information a masked byte carries, 0 for wildcards
+	constexpr uint32_t MaskedByteSelectivity(uint8_t byte, uint8_t mask) {
+		if (mask == 0) return 0;
+		return 17 - (uint32_t) std::bit_width(MaskedByteFrequency(byte, mask));
+	}
+
+	constexpr void SelectFilterWindow(PatternAnchors &anchors, const uint8_t *bytes, const uint8_t *mask, size_t size) {
+		const size_t window = size >= 8 ? 8 : 4;
+		if (size < window) return;
+
+		auto selectivity = [&](size_t i) {
+			for (uint32_t a = 0; a < anchors.count; a++)
+				if (anchors.offsets[a] == i) return 0u;	 // already compared by the kernel
+			return MaskedByteSelectivity(bytes[i], mask[i]);
+		};
+		uint32_t sum = 0, bestSum = 0;
+		size_t best = 0;
+		for (size_t i = 0; i < size; i++) {
+			sum += selectivity(i);
+			if (i >= window) sum -= selectivity(i - window);
+			if (i + 1 >= window && sum > bestSum) {
+				best = i + 1 - window;
+				bestSum = sum;
+			}
+		}
+		if (bestSum == 0) return;
+
+		anchors.filterOffset = (uint32_t) best;
+		anchors.filterSize = (uint32_t) window;
+		for (size_t i = 0; i < window; i++) {
+			anchors.filterBytes |= (uint64_t) (bytes[best + i] & mask[best + i]) << (8 * i);
+			anchors.filterMask |= (uint64_t) mask[best + i] << (8 * i);
+		}
+	}
+
+	// Picks the rarest unmasked bytes of a pattern as anchors. Two anchors are enough unless both of them are common,
+	// then a third one is added. Partially masked bytes count with the frequency of every value they match.
+	// count is 0 if every byte is masked. The filter window is picked once the anchors are known.
+	constexpr PatternAnchors ComputeAnchors(const uint8_t *bytes, const uint8_t *mask, size_t size) {
+		// Add a third anchor if a random position would still pass the first two with a chance of more than 1/4096
+		constexpr uint64_t thirdAnchorThreshold = (1ull << 32) / 4096;
+
+		PatternAnchors anchors{};
+		uint64_t combinedFrequency = 1;
+		while (anchors.count < anchors.offsets.size()) {
+			if (anchors.count == 2 && combinedFrequency <= thirdAnchorThreshold) break;
+
+			size_t best = size;
+			uint32_t bestFrequency = 0;
+			for (size_t i = 0; i < size; i++) {
+				if (mask[i] == 0) continue;
+				bool taken = false;
+				for (uint32_t a = 0; a < anchors.count; a++) taken |= anchors.offsets[a] == i;
+				if (taken) continue;
+				const auto frequency = MaskedByteFrequency(bytes[i], mask[i]);
+				if (best == size || frequency < bestFrequency) {
+					best = i;
+					bestFrequency = frequency;
+				}
+			}
+			if (best == size) break;
+
+			anchors.offsets[anchors.count++] = (uint32_t) best;
+			anchors.partial |= mask[best] != 0xFF;
+			combinedFrequency *= bestFrequency;
+		}
+		SelectFilterWindow(anchors, bytes, mask, size);
+		return anchors;
+	}
+
+}  // namespace MemScanner
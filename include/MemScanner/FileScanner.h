@@ -0,0 +1,72 @@
+#pragma once
+
+#include <MemScanner/MemScanner.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace MemScanner {
+
+	// Scans a file through a read only memory mapping instead of reading it into memory first, results are file offsets.
+	// Files up to windowSize bytes are mapped once, larger ones are mapped one window at a time for every scan.
+	// Windows overlap by the pattern length - 1, so matches across window borders are found as well
+	class FileScanner {
+#ifdef _WIN32
+		void *fileHandle = nullptr, *mappingHandle = nullptr;
+#else
+		int fd = -1;
+#endif
+		uint64_t fileSize = 0;
+		size_t windowSize;
+		const uint8_t *wholeFile = nullptr;	 // mapping of the entire file if it fits into one window
+		MemScanner scanner;
+
+		const uint8_t *mapView(uint64_t offset, size_t size, bool sequential);
+
+		void unmapView(const uint8_t *view, size_t size);
+
+		void close();
+
+		// Calls fn(offset, data, size) for every window, from the last one on if !forward, stops once fn returns true
+		void forEachWindow(size_t overlap, bool forward, const std::function<bool(uint64_t, const uint8_t *, size_t)> &fn);
+
+	public:
+		static constexpr uint64_t notFound = UINT64_MAX;
+		static constexpr size_t defaultWindowSize = size_t(1) << 30;
+
+		// windowSize is rounded up to the mapping granularity of the system
+		explicit FileScanner(const std::filesystem::path &path, size_t windowSize = defaultWindowSize);
+
+		FileScanner(const FileScanner &) = delete;
+
+		FileScanner &operator=(const FileScanner &) = delete;
+
+		~FileScanner();
+
+		uint64_t size() const { return fileSize; }
+
+		// The whole file if it is mapped at once, nullptr otherwise
+		const uint8_t *data() const { return wholeFile; }
+
+		MemScanner &getScanner() { return scanner; }
+
+		// Offset of the first (forward) or last match, notFound if there is none
+		template <bool forward>
+		uint64_t findSignature(std::span<const uint8_t> bytes, std::span<const uint8_t> mask);
+
+		template <bool forward>
+		uint64_t findSignature(const char *szSignature);
+
+		// Appends the offsets of the matches in ascending order, returns how many were added
+		size_t findAllSignatures(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, std::vector<uint64_t> &offsets, size_t maxMatches = SIZE_MAX);
+
+		// results[i] is the offset of the first match of patterns[i], every window is scanned for all patterns without a match at once
+		std::vector<uint64_t> findSignatures(std::span<const MemScanner::ParsedSignature> patterns);
+
+		std::vector<uint64_t> findSignatures(std::span<const char *const> signatures);
+	};
+
+}  // namespace MemScanner
@@ -18,6 +18,7 @@
 #ifdef _WIN32
 #include <intrin.h>
 inline unsigned char bitscanforward(unsigned long *index, unsigned long mask) { return _BitScanForward(index, mask); }
+inline unsigned char bitscanreverse(unsigned long *index, unsigned long mask) { return _BitScanReverse(index, mask); }
 
 template <typename T>
 inline void cpuid_impl(T cpuInfo[4], int f, int sub) {
@@ -37,8 +38,14 @@ inline unsigned char bitscanforward(unsigned long *index, unsigned long mask) {
 	return false;
 }
 
-inline void cpuid_impl(unsigned int cpuInfo[4], unsigned int function_id, int subfunction_id [[__maybe_unused__]]) {
-	__get_cpuid(function_id, &cpuInfo[0], &cpuInfo[1], &cpuInfo[2], &cpuInfo[3]);
+inline unsigned char bitscanreverse(unsigned long *index, unsigned long mask) {
+	if (mask == 0) return false;
+	*index = 63 - __builtin_clzll(mask);
+	return true;
+}
+
+inline void cpuid_impl(unsigned int cpuInfo[4], unsigned int function_id, int subfunction_id) {
+	__get_cpuid_count(function_id, (unsigned int) subfunction_id, &cpuInfo[0], &cpuInfo[1], &cpuInfo[2], &cpuInfo[3]);
 }
 
 #else
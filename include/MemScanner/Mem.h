@@ -2,7 +2,38 @@
 
 #include "MemScanner.h"
 
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace MemScanner {
+	// A readable mapping of the own process
+	struct MemoryRegion {
+		uintptr_t start = 0, end = 0;
+		bool writable = false, executable = false;
+		std::string path;  // file behind the mapping, on linux also pseudo names like [heap] or [stack]. Empty if anonymous
+
+		bool isFileBacked() const { return !path.empty() && path[0] != '['; }
+	};
+
+	struct RegionFilter {
+		std::optional<bool> writable, executable;  // nullopt accepts both
+		enum class Backing { Any, File, Anonymous } backing = Backing::Any;
+		std::string pathContains;  // empty accepts every path
+
+		bool accepts(const MemoryRegion &region) const;
+	};
+
+	struct RegionMatch {
+		void *address;
+		size_t region;	// index into ProcessScanResult::regions
+	};
+
+	struct ProcessScanResult {
+		std::vector<MemoryRegion> regions;	// the scanned mappings in ascending order
+		std::vector<RegionMatch> matches;	// in ascending order
+	};
+
 	class Mem {
 	protected:
 		MemScanner myScanner{};
@@ -10,14 +41,34 @@ namespace MemScanner {
 		static std::pair<uint64_t, uint64_t> ResolveModuleSection(void *module, const char *section);
 
 	public:
+		// Readable mappings that pass filter in ascending order, from /proc/self/maps on linux and VirtualQuery on windows.
+		// Mappings that fault on reads even though they are readable (device memory, [vvar]) are left out. On linux file mappings end
+		// with the last page of the file, a mapping whose file cannot be looked at (deleted or replaced without /proc/self/map_files) is left out
+		static std::vector<MemoryRegion> GetMemoryRegions(const RegionFilter &filter = {});
+
+		// Scans every mapping that passes filter with findAllSignaturesInRangesParallel. Adjacent mappings are scanned as one range,
+		// a match that crosses their border belongs to the mapping it starts in. Anonymous memory contains the pattern itself.
+		// Mappings must not be unmapped while they are scanned, and mapped files must not be truncated (reading behind their end raises SIGBUS)
+		ProcessScanResult findAllSignaturesInProcess(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const RegionFilter &filter = {},
+													 size_t maxMatches = SIZE_MAX);
+
+		ProcessScanResult findAllSignaturesInProcess(const char *szSignature, const RegionFilter &filter = {}, size_t maxMatches = SIZE_MAX);
+
 		void startSigThread() { myScanner.startSigRunnerThread(); }
 
 		void stopSigThread() { myScanner.stopSigRunnerThread(); }
 
 		MemScanner &getScanner() { return this->myScanner; }
 
+		// module is the module handle on windows. On linux it can be any address within a loaded object, nullptr is the main executable.
+		// Sections are resolved from the ELF section headers of the file and cached until objects are loaded or unloaded
 		static std::pair<uint64_t, uint64_t> GetSectionRange(void *module, const char *name);
 
+		// Handle of the loaded module that GetModuleHandleA finds (windows) or whose file name is name (linux), nullptr = main executable.
+		// On linux name may leave out the ".so" and version suffix: "libc" and "libc.so" find "libc.so.6", but "libc" does not find "libcap.so.2".
+		// Returns nullptr if there is no such module
+		static void *FindModule(const char *name);
+
 		template <bool forward>
 		void *findSignature(const char *szSignature, bool enableCache = true, void *module = nullptr, const char *section = ".text");
 
@@ -1,10 +1,26 @@
 #pragma once
 
+#include <MemScanner/Anchors.h>
+#include <MemScanner/NGramIndex.h>
+#include <MemScanner/Signature.h>
+#include <MemScanner/ThreadPool.h>
+
+#include <array>
+#include <atomic>
 #include <condition_variable>
+#include <coroutine>
+#include <cstdint>
 #include <deque>
-#include <map>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <mutex>
 #include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -35,7 +51,7 @@ namespace MemScanner {
 				bytesHash &= maskHash;
 			}
 
-			SearchMapKey(const std::vector<uint8_t> &byt, const std::vector<uint8_t> &mas) {
+			SearchMapKey(std::span<const uint8_t> byt, std::span<const uint8_t> mas) {
 				numBytesUsed = (uint8_t) std::min((int) byt.size(), 8);
 				for (unsigned int i = 0; i < numBytesUsed; i++) {
 					bytes[i] = byt[i];
@@ -69,71 +85,732 @@ namespace MemScanner {
 			SearchMapValue &operator=(SearchMapValue &&) = default;
 		};
 
+		// On-disk layout of a saved search map: the header followed by numEntries fixed size entries
+		struct SearchMapFileHeader {
+			static constexpr uint32_t currentVersion = 1;
+
+			char magic[8];
+			uint32_t version;
+			uint32_t numEntries;
+			uint64_t rangeSize;
+			uint64_t contentHash;
+		};
+
+		struct SearchMapFileEntry {
+			uint64_t bytes;
+			uint64_t mask;
+			uint64_t numBytesUsed;
+			uint64_t startOffset, endOffset;  // relative to the start of the range
+		};
+
+		// Pending background search of one key, a key that is requested more often (or has a larger region left) is searched first
 		struct NeedSearchObj {
 			SearchMapKey key;
-			bool isInSearch = false;
+			uint32_t numRequests = 0;
+			uintptr_t regionSize = 0;
+
+			bool operator<(const NeedSearchObj &o) const {
+				return numRequests != o.numRequests ? numRequests < o.numRequests : regionSize < o.regionSize;
+			}
+		};
+
+		struct NeedSearchState {
 			SearchMapValue regionToBeSearched;
+			uint32_t numRequests = 0;
+			bool isInSearch = false;
+		};
+
+		// Open addressing table with a memory budget, lookups never take a lock.
+		// Every slot has a sequence counter that is odd while the slot is written, readers retry if it changed during their read.
+		// Writers are serialized by writeMutex. Once the budget is used up, inserting a new key evicts the least valuable of a few entries
+		// next to the clock hand: few (decaying) hits and a wide region, i.e. keys that narrow the search the least.
+		// Entries are removed by backward shift deletion, a lookup that races with it can miss the moved entry. For the caller that is a
+		// cache miss: the range is scanned once more without narrowing and the key may be queued for the sig runner again
+		class ConcurrentSearchMap {
+		public:
+			static constexpr size_t defaultBudget = 1 << 20;
+			static constexpr size_t initialCapacity = 64;  // power of two, the table doubles while it is more than half full
+			static constexpr size_t numEvictionSamples = 8;
+			// A lookup writes the hit counter (adding hitSampleInterval) with a chance of 1/hitSampleInterval, so hot keys that many
+			// threads look up do not bounce their cache line. The choice is random per lookup: a counter would always pick the same
+			// key of a window whose keys are looked up in a fixed order
+			static constexpr uint32_t hitSampleInterval = 16;
+
+			ConcurrentSearchMap();
+
+			// Counts as a hit of the entry, see hitSampleInterval
+			bool find(const SearchMapKey &key, SearchMapValue &value) const;
+
+			// Inserts or overwrites the entry for key, evicts another entry if the budget is used up.
+			// Returns false if the budget is too small for a single entry
+			bool insert(const SearchMapKey &key, const SearchMapValue &value);
+
+			void clear();
+
+			size_t size() const { return numEntries.load(std::memory_order_relaxed); }
+
+			// Bytes the slot table may use, a smaller budget evicts entries right away but keeps the allocated table.
+			// Tables that were replaced by a larger one stay allocated until destruction since lookups may still read them
+			void setBudget(size_t bytes);
+
+			size_t getBudget() const { return budget.load(std::memory_order_relaxed); }
+
+			// Number of entries that fit into the budget
+			size_t maxEntries() const { return entryLimit.load(std::memory_order_relaxed); }
+
+			size_t numEvictions() const { return evictions.load(std::memory_order_relaxed); }
+
+			// Approximate number of hits of key, 0 if it is not in the map. Takes the write lock
+			uint32_t numHits(const SearchMapKey &key);
+
+			// Calls fn(key, value) for every entry while holding the write lock
+			template <class Fn>
+			void forEach(Fn &&fn) {
+				std::lock_guard lock(writeMutex);
+				const auto &current = *tables.back();
+				for (size_t i = 0; i < current.capacity; i++) {
+					const auto &slot = current.slots[i];
+					if (slot.numBytesUsed.load(std::memory_order_relaxed) == 0) continue;
+					fn(slot.loadKey(), SearchMapValue(slot.start.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed)));
+				}
+			}
+
+		private:
+			struct Slot {
+				std::atomic<uint32_t> sequence{0};
+				mutable std::atomic<uint32_t> hits{0};	// approximate, sampled and concurrent lookups may lose increments
+				std::atomic<uint64_t> bytes{0}, mask{0}, numBytesUsed{0};  // numBytesUsed == 0 marks an empty slot
+				std::atomic<uint64_t> start{0}, end{0};
+
+				SearchMapKey loadKey() const;
+
+				SearchMapValue loadValue() const { return {start.load(std::memory_order_relaxed), end.load(std::memory_order_relaxed)}; }
+
+				void store(const SearchMapKey &key, const SearchMapValue &value, uint32_t numHits);
+			};
+
+			struct Table {
+				size_t capacity;
+				std::unique_ptr<Slot[]> slots;
+
+				explicit Table(size_t capacity) : capacity(capacity), slots(std::make_unique<Slot[]>(capacity)) {}
+			};
+
+			static size_t SlotIndex(const SearchMapKey &key, size_t capacity);
+
+			// The following need writeMutex
+			static void PlaceEntry(Table &table, const SearchMapKey &key, const SearchMapValue &value, uint32_t numHits);
+			void grow();
+			void evictOne();
+			void erase(Table &table, size_t index);
+
+			std::atomic<Table *> table;					// == tables.back()
+			std::vector<std::unique_ptr<Table>> tables;	// previous tables are kept alive for lookups that still use them
+			std::mutex writeMutex;
+			std::atomic<size_t> numEntries{0}, evictions{0};
+			std::atomic<size_t> budget{0}, entryLimit{0};  // written under writeMutex
+			size_t maxCapacity = 0, clockHand = 0;
+		};
+
+		// Search map keys of every prefix (up to 8 bytes) of the pattern that starts at one offset
+		struct SearchMapWindow {
+			std::array<SearchMapKey, 8> keys{};
+			uint8_t numKeys = 0;
+
+			SearchMapWindow() = default;
+
+			// size is the number of pattern bytes from bytes on
+			SearchMapWindow(const uint8_t *bytes, const uint8_t *mask, size_t size) {
+				for (unsigned int i = 0; i < std::min<size_t>(size, 8); i++)
+					if (mask[i] != 0) keys[numKeys++] = SearchMapKey(bytes, mask, i + 1);
+			}
+		};
+
+		using ParsedSignature = std::pair<std::vector<uint8_t>, std::vector<uint8_t>>;
+
+		// Signature that is prepared once and then scanned for without any allocation or per call setup.
+		// Bytes and mask are 32 byte aligned and zero padded to a multiple of 32, the anchors and search map keys are precomputed.
+		// A moved-from Pattern is empty, scanning for it throws like an empty signature does
+		class Pattern {
+			std::unique_ptr<uint8_t[]> storage;
+			const uint8_t *alignedBytes = nullptr, *alignedMask = nullptr;
+			size_t patternSize = 0;
+			PatternAnchors patternAnchors{};
+			std::vector<SearchMapWindow> windows;  // windows[i] starts at pattern offset i, only offset 0 for patterns of up to 8 bytes
+
+		public:
+			static constexpr size_t alignment = 32;
+
+			Pattern(std::span<const uint8_t> bytes, std::span<const uint8_t> mask);
+
+			explicit Pattern(const char *szSignature);
+
+			Pattern(const Pattern &other);
+
+			Pattern(Pattern &&other) noexcept { *this = std::move(other); }
+
+			Pattern &operator=(const Pattern &other) { return *this = Pattern(other); }
+
+			Pattern &operator=(Pattern &&other) noexcept;
+
+			size_t size() const { return patternSize; }
+
+			std::span<const uint8_t> bytes() const { return {alignedBytes, patternSize}; }
+
+			std::span<const uint8_t> mask() const { return {alignedMask, patternSize}; }
+
+			// size() rounded up to a multiple of alignment, the padding has a zero mask
+			size_t paddedSize() const { return (patternSize + alignment - 1) & ~(alignment - 1); }
+
+			const PatternAnchors &anchors() const { return patternAnchors; }
+
+			std::span<const SearchMapWindow> searchMapWindows() const { return windows; }
+		};
+
+		// Lookup structure for scanning many patterns in a single pass.
+		// Every pattern is anchored on two adjacent bytes (or a single byte if it has no two adjacent fully unmasked bytes),
+		// candidates are found with a prefilter and then looked up by their anchor.
+		struct MultiPatternTable {
+			std::span<const ParsedSignature> patterns;
+			std::vector<uint32_t> anchorOffsets;					  // offset of the anchor in every pattern
+			std::vector<std::pair<uint16_t, uint32_t>> pairAnchors;	  // (bytes[off] | bytes[off + 1] << 8, pattern index), sorted
+			std::vector<std::pair<uint8_t, uint32_t>> singleAnchors;  // (bytes[off], pattern index), sorted
+			std::vector<uint32_t> unanchored;						  // patterns without a fully unmasked byte, scanned one by one
+			std::array<uint64_t, 1024> pairBitmap{};
+			std::array<uint64_t, 4> singleBitmap{};
+
+			// Teddy style nibble tables, one bit per bucket. A position is a candidate if
+			// lo0[b0 & 0xF] & hi0[b0 >> 4] & lo1[b1 & 0xF] & hi1[b1 >> 4] is non-zero
+			alignas(32) std::array<uint8_t, 16> lo0{}, hi0{}, lo1{}, hi1{};
+			bool useNibblePrefilter = false;
+
+			MultiPatternTable(std::span<const ParsedSignature> patterns);
+
+			bool isCandidate(const uint8_t *p, uintptr_t rangeEnd) const {
+				if (singleBitmap[p[0] >> 6] & (1ull << (p[0] & 63))) return true;
+				if ((uintptr_t) p + 1 >= rangeEnd) return false;
+				const uint16_t anchor = (uint16_t) (p[0] | (p[1] << 8));
+				return (pairBitmap[anchor >> 6] & (1ull << (anchor & 63))) != 0;
+			}
+
+			// Checks every pattern whose anchor is at p, stores newly found matches. Returns the number of new matches
+			unsigned int verify(uintptr_t p, uintptr_t rangeStart, uintptr_t rangeEnd, std::vector<void *> &results) const;
+		};
+
+		// Progress of a find-all scan, findNextSignatureFastAVX2 resumes with the unverified anchor matches of the current block.
+		// VectorSSE is the 16 byte block scan of findNextSignatureFastSSE on CPUs without AVX2
+		struct ScanCursor {
+			enum class Phase : uint8_t { Start, Vector, VectorSSE, Scalar, Done };
+
+			Phase phase = Phase::Start;
+			uintptr_t position = 0;	 // next block to load, or the next start the scalar scan tests
+			uintptr_t blockStart = 0;
+			uint32_t pendingMatches = 0;  // anchor matches of the block at blockStart that were not verified yet
+			PatternAnchors anchors{};	  // selected on the first call if left empty
+
+			ScanCursor() = default;
+
+			explicit ScanCursor(uintptr_t start) : position(start) {}
+		};
+
+		// Lazily enumerates the matches of a pattern in ascending order, the range is only scanned as far as the iteration goes
+		class SignatureMatches {
+			MemScanner *scanner;
+			ParsedSignature pattern;
+			uintptr_t rangeStart, rangeEnd;
+			size_t maxMatches;
+
+		public:
+			class iterator {
+				const SignatureMatches *matches = nullptr;
+				ScanCursor cursor;
+				void *current = nullptr;
+				size_t count = 0;
+
+				void advance() {
+					current = count < matches->maxMatches
+								  ? matches->scanner->findNextSignatureFastAVX2(matches->pattern.first, matches->pattern.second, matches->rangeEnd, cursor)
+								  : nullptr;
+					if (current != nullptr) count++;
+				}
+
+			public:
+				using iterator_category = std::input_iterator_tag;
+				using value_type = void *;
+				using difference_type = std::ptrdiff_t;
+
+				iterator() = default;
+
+				explicit iterator(const SignatureMatches *matches) : matches(matches), cursor(matches->rangeStart) { advance(); }
+
+				void *operator*() const { return current; }
+
+				iterator &operator++() {
+					advance();
+					return *this;
+				}
+
+				void operator++(int) { advance(); }
+
+				bool operator==(std::default_sentinel_t) const { return current == nullptr; }
+			};
+
+			SignatureMatches(MemScanner *scanner, ParsedSignature pattern, uintptr_t start, uintptr_t end, size_t maxMatches)
+				: scanner(scanner), pattern(std::move(pattern)), rangeStart(start), rangeEnd(end), maxMatches(maxMatches) {}
+
+			iterator begin() const { return iterator(this); }
+
+			std::default_sentinel_t end() const { return {}; }
+		};
+
+		// Handle of a lookup started by findSignatureInRangeAsync, copies refer to the same lookup.
+		// Completion can be waited for (get, wait), observed with a callback (then) or awaited in a coroutine (co_await)
+		class AsyncSignature {
+			friend class MemScanner;
+
+			struct State {
+				std::mutex mutex;
+				std::condition_variable finished;
+				bool done = false;
+				void *result = nullptr;
+				std::exception_ptr error;
+				std::vector<std::function<void()>> continuations;  // run by the thread that completes the lookup
+
+				void complete(void *match, std::exception_ptr exception);
+			};
+
+			std::shared_ptr<State> state;
+
+			explicit AsyncSignature(std::shared_ptr<State> state) : state(std::move(state)) {}
+
+		public:
+			bool ready() const;
+
+			void wait() const;
+
+			// Waits for the lookup, returns the match (nullptr if there is none) or rethrows what the scan threw
+			void *get() const;
+
+			// Calls fn on the worker thread that completes the lookup, or right away if it is already complete. fn must not throw.
+			// fn must not wait for another async lookup either: the worker is busy until fn returns, with a single worker that wait never ends
+			void then(std::function<void(const AsyncSignature &)> fn) const;
+
+			bool await_ready() const { return this->ready(); }
+
+			// The coroutine continues on the worker thread that completes the lookup, like fn of then it must not block on another lookup
+			bool await_suspend(std::coroutine_handle<> handle) const;
+
+			void *await_resume() const { return this->get(); }
+
+			// Handles of coalesced requests compare equal
+			bool operator==(const AsyncSignature &other) const { return state == other.state; }
+		};
+
+		// Counters collected while enableStats(true) is in effect, summed over all threads by getStats
+		struct ScanStats {
+			enum Kernel : unsigned int { Fast1, Fast8, SSE, SSE42, AVX2, MultiFast1, MultiAVX2, NumKernels };
+
+			// Start positions every kernel tested itself, the part of a range a kernel hands on to another one counts for that one
+			std::array<uint64_t, NumKernels> bytesScanned{};
+			uint64_t candidates = 0;	   // positions that passed the anchor (or prefix) test and went through the full compare
+			uint64_t verifiedMatches = 0;  // candidates that matched completely
+			uint64_t searchMapHits = 0, searchMapMisses = 0;
+			uint64_t narrowedScans = 0;								// scans that consulted the search map
+			uint64_t bytesRequested = 0, bytesAfterNarrowing = 0;	// range sizes of those scans before and after the search map
+			uint64_t sigRunnerJobs = 0, sigRunnerBytes = 0;			// background searches and the bytes they scanned
+			uint64_t resultCacheHits = 0, resultCacheMisses = 0;	// lookups answered from the result cache or scanned
+			size_t pendingSearches = 0;								// queued or running background searches when getStats was called
 		};
 
 	private:
-		bool shouldShutdown;
-		std::mutex shutdownMutex;
-		std::condition_variable wakeup;
-		std::thread sigRunnerThread;
+		ConcurrentSearchMap searchMap;
+
+		// Guards everything below, the sig runner threads sleep on workAvailable until a key is queued
+		std::mutex needSearchMutex;
+		std::condition_variable workAvailable;
+		std::vector<std::thread> sigRunnerThreads;
+		// Incremented by stopSigRunnerThread, workers return once it differs from the value they were started with.
+		// A start that races with a stop therefore cannot keep the stopped workers alive
+		uint64_t sigRunnerPool = 0;
+		uint64_t cacheGeneration = 0;  // incremented by evictCache, searches that started before are not added to the search map
+		std::unordered_map<SearchMapKey, NeedSearchState, hash_fn> needSearchKeys;	// queued or currently searched keys
+		// max heap, a key is pushed again whenever its priority rises, outdated entries are skipped when they are popped
+		std::vector<NeedSearchObj> needSearchHeap;
+
+		struct AsyncJob {
+			std::string key;  // identifies identical requests, see asyncInFlight
+			std::vector<uint8_t> bytes, mask;
+			uintptr_t start, end;
+			bool forward, enableCache;
+			std::shared_ptr<AsyncSignature::State> state;
+		};
 
-		std::shared_mutex searchMapMutex;
-		std::unordered_map<SearchMapKey, SearchMapValue, hash_fn> searchMap;
-		std::recursive_mutex needSearchMutex;
+		// Also guarded by needSearchMutex. The sig runner threads take async jobs before search map keys, somebody waits for them
+		std::deque<AsyncJob> asyncJobs;
+		std::unordered_map<std::string, std::shared_ptr<AsyncSignature::State>> asyncInFlight;	// queued or running async jobs by key
 
-		std::multimap<int, NeedSearchObj> needSearchMap;
+		void runAsyncJob(AsyncJob &job);
 
-		void addToSearchMap(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t start, uintptr_t end);
+		// Exact results by lookup, see enableResultCache. Keys are built by ResultKey
+		std::atomic<bool> resultCacheEnabled{false};
+		std::shared_mutex resultCacheMutex;	 // lookups share it, storing and invalidating take it exclusively
+		// Guarded by resultCacheMutex. Lookups that started before an invalidation are not cached
+		uint64_t resultGeneration = 0;
+		std::unordered_map<std::string, void *> resultCache;
+		size_t resultCacheBytes = 0, resultCacheBudget = defaultResultCacheBudget;	// see ResultEntrySize
+		size_t resultEvictionHand = 0;
+
+		// Approximate memory of an entry: the key plus the node, its bucket and the string header
+		static size_t ResultEntrySize(const std::string &key) { return key.size() + 64; }
+
+		// Drops one entry, resultCacheMutex has to be held exclusively
+		void evictResult();
+
+		// Pattern keys hold the bytes and mask, text keys the signature text, so "48 8B" and the bytes {0x48, 0x8B} never share a key
+		enum class ResultKeyKind : uint8_t { Pattern, Text };
+
+		// The range, direction and kind followed by the pattern bytes and mask, or by the signature text
+		static void ResultKey(std::string &key, ResultKeyKind kind, bool forward, std::string_view signature, std::string_view mask, uintptr_t start,
+							  uintptr_t end);
+
+		// Returns true and sets result on a hit, otherwise sets generation to the value storeResult needs
+		bool findCachedResult(const std::string &key, void *&result, uint64_t &generation);
+
+		void storeResult(const std::string &key, void *result, uint64_t generation);
+
+		bool useResultCache(bool enableCache) const { return enableCache && resultCacheEnabled.load(std::memory_order_relaxed); }
+
+		// Answers the lookup from the result cache or runs scan and caches what it returns
+		template <bool forward, typename Scan>
+		void *findSignatureCached(ResultKeyKind kind, std::string_view signature, std::string_view mask, uintptr_t start, uintptr_t end, bool allowAddToCache,
+								  Scan &&scan) {
+			thread_local std::string keyBuffer;
+			MemScanner::ResultKey(keyBuffer, kind, forward, signature, mask, start, end);
+			void *result;
+			uint64_t generation;
+			if (this->findCachedResult(keyBuffer, result, generation)) return result;
+
+			const std::string key = keyBuffer;	// scan may run cached lookups on this thread as well
+			result = scan();
+			if (allowAddToCache) this->storeResult(key, result, generation);
+			return result;
+		}
+
+		// findSignatureInRange without the result cache
+		template <bool forward>
+		void *findSignatureUncached(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, bool enableCache,
+									bool allowAddToCache);
+
+		static std::string_view AsChars(std::span<const uint8_t> bytes) { return {reinterpret_cast<const char *>(bytes.data()), bytes.size()}; }
+
+		std::mutex scanPoolMutex;
+		std::unique_ptr<ThreadPool> scanPool;  // created by the first parallel scan
+		unsigned int numScanThreads = 0;	   // 0 = one per hardware thread
+
+		ThreadPool &getScanPool();
+
+		std::mutex indexMutex;
+		std::vector<std::shared_ptr<const NGramIndex>> indexes;
+		std::atomic<size_t> numIndexes{0};	// lets lookups skip indexMutex while there is no index
+
+		// Answers from an index that covers [start, end) if there is one, returns false otherwise
+		template <bool forward>
+		bool findSignatureIndexed(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, void *&result);
+
+		template <bool forward>
+		void *findSignatureParallel(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors, SearchMapValue range);
+
+		void addToSearchMap(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end);
+
+		// needSearchMutex has to be held, returns false if nothing is queued
+		bool popSearchJob(SearchMapKey &key, SearchMapValue &regionToBeSearched, uint64_t &generation);
+
+		void runSearchJob(const SearchMapKey &key, SearchMapValue regionToBeSearched, uint64_t generation);
 
 		bool findInSearchMap(const SearchMapKey &key, SearchMapValue &region, bool allowAdd, SearchMapValue &originalRegion);
 
-		void getOrAddToSearchMap8Byte(const uint8_t *bytes, const uint8_t *mask, unsigned int size, SearchMapValue &region, bool allowAdd,
-									  SearchMapValue &originalRegion);
+		void getOrAddToSearchMapWindow(const SearchMapWindow &window, SearchMapValue &region, bool allowAdd, SearchMapValue &originalRegion);
+
+		// windowAt(i) returns the SearchMapWindow at pattern offset i
+		template <class WindowAt>
+		void getOrAddToSearchMap(std::span<const uint8_t> mask, WindowAt &&windowAt, SearchMapValue &region, bool allowAdd);
+
+		void getOrAddToSearchMap(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, SearchMapValue &region, bool allowAdd);
+
+		enum StatCounter : unsigned int {
+			// ScanStats::Kernel values count bytes scanned
+			Candidates = ScanStats::NumKernels,
+			VerifiedMatches,
+			SearchMapHits,
+			SearchMapMisses,
+			NarrowedScans,
+			BytesRequested,
+			BytesAfterNarrowing,
+			SigRunnerJobs,
+			SigRunnerBytes,
+			ResultCacheHits,
+			ResultCacheMisses,
+			NumStatCounters
+		};
 
-		void getOrAddToSearchMap(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, SearchMapValue &region, bool allowAdd);
+		// Every thread counts into its own block, so counting never contends. Blocks outlive their threads to keep the totals
+		struct alignas(64) StatsBlock {
+			std::thread::id owner;
+			std::array<std::atomic<uint64_t>, NumStatCounters> counters{};
+		};
+
+		std::atomic<bool> statsEnabled{false};
+		const uint64_t instanceId;	// identifies this scanner in the per-thread block caches
+		std::mutex statsMutex;
+		std::deque<StatsBlock> statsBlocks;	 // guarded by statsMutex, a deque so blocks never move
+
+		// The block of the calling thread. Each thread caches the block of the last scanner it counted for
+		StatsBlock &threadStats();
+
+		void countStat(StatCounter counter, uint64_t value) {
+			if (!statsEnabled.load(std::memory_order_relaxed)) return;
+			threadStats().counters[counter].fetch_add(value, std::memory_order_relaxed);
+		}
+
+		// Called once per kernel run with the number of start positions it tested
+		void countScan(ScanStats::Kernel kernel, uint64_t positions, uint64_t candidates, uint64_t matches) {
+			if (!statsEnabled.load(std::memory_order_relaxed)) return;
+			auto &counters = threadStats().counters;
+			counters[kernel].fetch_add(positions, std::memory_order_relaxed);
+			counters[Candidates].fetch_add(candidates, std::memory_order_relaxed);
+			counters[VerifiedMatches].fetch_add(matches, std::memory_order_relaxed);
+		}
+
+		// Counts how much the search map narrowed [start, end) to region
+		void countNarrowing(uintptr_t start, uintptr_t end, const SearchMapValue &region);
 
-		static void SigRunner(MemScanner *me);
+		SearchMapValue prepareSearchRange(const Pattern &pattern, uintptr_t start, uintptr_t end, bool enableCache, bool allowAddToCache);
+
+		// Validates the pattern and narrows [start, end) with the search map if enabled
+		SearchMapValue prepareSearchRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, bool enableCache,
+										  bool allowAddToCache);
+
+		static void SigRunner(MemScanner *me, uint64_t pool);
 
 	public:
+		// Ranges smaller than this are scanned on the calling thread by findSignatureInRangeParallel
+		static constexpr size_t parallelScanThreshold = 0x400000;
+		// Unit of work of a parallel scan, small enough to stay in L2 and to cancel the scan quickly
+		static constexpr size_t parallelScanChunkSize = 0x40000;
+		static constexpr size_t defaultResultCacheBudget = 1 << 20;
+
+		MemScanner();
+
 		~MemScanner();
 
 		static bool hasFullAVXSupport();
 
+		static bool hasSSE42Support();
+
+		// Bytes are hex ("8B"), wildcards ("??"), nibble wildcards ("4?", "?5") or carry an explicit bit mask ("C0&F8").
+		// A memory byte m matches if (m & mask) == byte, bytes are returned with the mask already applied.
+		// Leading wildcards are kept so matches point at the first byte of the signature, trailing ones are removed
 		static std::pair<std::vector<uint8_t>, std::vector<uint8_t>> ParseSignature(const char *signature);
 
+		static PatternAnchors SelectAnchors(std::span<const uint8_t> bytes, std::span<const uint8_t> mask);
+
+		// Searches the queued key with the highest priority on the calling thread, returns false if nothing is queued
 		bool doSearchSingleMapKey();
 
+		// Number of keys that are queued or currently searched
+		size_t numPendingSearches();
+
 		template <bool forward>
-		void *findSignatureFast1(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t start, uintptr_t end);
+		void *findSignatureFast1(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end) {
+			return this->findSignatureFast1<forward>(bytes, mask, MemScanner::SelectAnchors(bytes, mask), start, end);
+		}
 
 		template <bool forward>
-		void *findSignatureFast8(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t start, uintptr_t end);
+		void *findSignatureFast1(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors, uintptr_t start, uintptr_t end);
 
 		template <bool forward>
-		void *findSignatureFastAVX2(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t start, uintptr_t end);
+		void *findSignatureFast8(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end);
 
-	protected:
 		template <bool forward>
-		void *findSignatureFastAVX2_SecondByteMasked(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t start, uintptr_t end);
+		void *findSignatureFastSSE(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end) {
+			return this->findSignatureFastSSE<forward>(bytes, mask, MemScanner::SelectAnchors(bytes, mask), start, end);
+		}
+
+		template <bool forward>
+		void *findSignatureFastSSE(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors, uintptr_t start,
+								   uintptr_t end);
+
+		// Matches the leading run of unmasked bytes with pcmpestrm, requires SSE4.2
+		template <bool forward>
+		void *findSignatureFastSSE42(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end);
+
+		template <bool forward>
+		void *findSignatureFastAVX2(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end) {
+			return this->findSignatureFastAVX2<forward>(bytes, mask, MemScanner::SelectAnchors(bytes, mask), start, end);
+		}
+
+		template <bool forward>
+		void *findSignatureFastAVX2(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors, uintptr_t start,
+									uintptr_t end);
+
+		// Both return the number of patterns that are still missing. Anchors below scanFrom are skipped
+		unsigned int findSignaturesFast1(const MultiPatternTable &table, uintptr_t start, uintptr_t end, std::vector<void *> &results, unsigned int remaining,
+										 uintptr_t scanFrom = 0);
+
+		unsigned int findSignaturesFastAVX2(const MultiPatternTable &table, uintptr_t start, uintptr_t end, std::vector<void *> &results,
+											unsigned int remaining);
+
+		// Returns the next match at or after the cursor, nullptr once the range is exhausted
+		void *findNextSignatureFastAVX2(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t end, ScanCursor &cursor);
+
+		// The VectorSSE phase of findNextSignatureFastAVX2, leaves the cursor in the Scalar phase once no full block is left
+		void *findNextSignatureFastSSE(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t end, ScanCursor &cursor);
 
-	public:
 		// start inclusive, end exclusive
 		template <bool forward>
-		void *findSignatureInRange(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t start, uintptr_t end, bool enableCache = true,
+		void *findSignatureInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, bool enableCache = true,
 								   bool allowAddToCache = true);
 
 		template <bool forward>
 		void *findSignatureInRange(const char *szSignature, uintptr_t start, uintptr_t end, bool enableCache = true, bool allowAddToCache = true);
 
-		void startSigRunnerThread();
+		template <bool forward>
+		void *findSignatureInRange(const Pattern &pattern, uintptr_t start, uintptr_t end, bool enableCache = true, bool allowAddToCache = true);
+
+		// Compile time signature, e.g. findSignatureInRange<true>(Signature<"48 8B 05 ?? ?? ?? ??">{}, start, end).
+		// Does not parse or allocate, the kernel is specialized on the pattern
+		template <bool forward, CompileTimeSignature Sig>
+		void *findSignatureInRange(Sig, uintptr_t start, uintptr_t end, bool enableCache = true, bool allowAddToCache = true) {
+			auto scan = [&]() -> void * {
+				auto val = this->prepareSearchRange(Sig::bytes, Sig::mask, start, end, enableCache, allowAddToCache);
+				if (val.start > val.end || val.end - val.start < Sig::size) return nullptr;
+
+				if (MemScanner::hasFullAVXSupport()) return detail::FindSignatureAVX2<Sig, forward>(val.start, val.end);
+				return detail::FindSignatureSSE2<Sig, forward>(val.start, val.end);
+			};
+			if (this->useResultCache(enableCache))
+				return this->findSignatureCached<forward>(ResultKeyKind::Pattern, AsChars(Sig::bytes), AsChars(Sig::mask), start, end, allowAddToCache, scan);
+			return scan();
+		}
+
+		// Same result as findSignatureInRange, but splits the range into chunks that are scanned by the internal thread pool.
+		// Chunks are handed out in scan order and chunks behind an already found match are skipped
+		template <bool forward>
+		void *findSignatureInRangeParallel(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end,
+										   bool enableCache = true, bool allowAddToCache = true);
+
+		template <bool forward>
+		void *findSignatureInRangeParallel(const char *szSignature, uintptr_t start, uintptr_t end, bool enableCache = true, bool allowAddToCache = true);
+
+		template <bool forward>
+		void *findSignatureInRangeParallel(const Pattern &pattern, uintptr_t start, uintptr_t end, bool enableCache = true, bool allowAddToCache = true);
+
+		// Finds the first match of every pattern in one pass over [start, end).
+		// results[i] belongs to patterns[i] and has the same value a forward findSignatureInRange would return.
+		std::vector<void *> findSignaturesInRange(std::span<const ParsedSignature> patterns, uintptr_t start, uintptr_t end);
+
+		std::vector<void *> findSignaturesInRange(std::span<const char *const> signatures, uintptr_t start, uintptr_t end);
+
+		// Finds every (possibly overlapping) match in [start, end) in ascending order, stops after maxMatches.
+		// Returns the number of matches that were appended to results
+		size_t findAllSignaturesInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end,
+										std::vector<void *> &results, size_t maxMatches = SIZE_MAX, bool enableCache = true);
+
+		size_t findAllSignaturesInRange(const char *szSignature, uintptr_t start, uintptr_t end, std::vector<void *> &results, size_t maxMatches = SIZE_MAX,
+										bool enableCache = true);
+
+		// Same as above but writes to a caller provided buffer, returns the number of matches written (at most capacity)
+		size_t findAllSignaturesInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, void **out,
+										size_t capacity, bool enableCache = true);
+
+		size_t findAllSignaturesInRange(const Pattern &pattern, uintptr_t start, uintptr_t end, void **out, size_t capacity, bool enableCache = true);
+
+		// Finds every match in all ranges in ascending order on the parallel scan threads, without the search map.
+		// Ranges may come in any order but must not overlap. With maxMatches only the lowest maxMatches matches are appended
+		size_t findAllSignaturesInRangesParallel(std::span<const uint8_t> bytes, std::span<const uint8_t> mask,
+												 std::span<const std::pair<uintptr_t, uintptr_t>> ranges, std::vector<void *> &results,
+												 size_t maxMatches = SIZE_MAX);
+
+		// Lazy form, e.g. for (void *match : scanner.iterateSignatureInRange("48 8B 05", start, end)) ...
+		SignatureMatches iterateSignatureInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end,
+												 size_t maxMatches = SIZE_MAX, bool enableCache = true);
+
+		SignatureMatches iterateSignatureInRange(const char *szSignature, uintptr_t start, uintptr_t end, size_t maxMatches = SIZE_MAX,
+												 bool enableCache = true);
+
+		// Number of threads (including the calling one) used by findSignatureInRangeParallel, 0 = one per hardware thread
+		void setParallelScanThreads(unsigned int numThreads);
 
+		// Starts numWorkers background threads (0 = one per hardware thread) that search queued search map keys.
+		// Can be called again after stopSigRunnerThread
+		void startSigRunnerThread(unsigned int numWorkers = 1);
+
+		// Async jobs that did not start yet are run on the calling thread, so nobody waits for them forever
 		void stopSigRunnerThread();
 
+		// Queues the lookup for the sig runner threads and returns immediately. The workers are never started implicitly, if none run
+		// (see startSigRunnerThread) the lookup runs on the calling thread and the returned handle is already complete.
+		// A request for the same pattern, range, direction and cache setting as a queued or running one shares its result.
+		// Invalid patterns throw right away, like they do for findSignatureInRange
+		template <bool forward>
+		AsyncSignature findSignatureInRangeAsync(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end,
+												 bool enableCache = true);
+
+		template <bool forward>
+		AsyncSignature findSignatureInRangeAsync(const char *szSignature, uintptr_t start, uintptr_t end, bool enableCache = true);
+
+		// Drops the search map, queued searches and cached results
 		void evictCache();
+
+		// Remembers the result of every findSignatureInRange call with enableCache, including nullptr, by pattern, range and direction.
+		// Repeating a lookup is a single hash probe then, but the memory is not looked at again: call invalidateResults whenever a
+		// range changes, e.g. after a module reload or once HashRange differs. Disabled by default, disabling drops all results
+		void enableResultCache(bool enable);
+
+		bool isResultCacheEnabled() const { return resultCacheEnabled.load(std::memory_order_relaxed); }
+
+		// Memory ceiling of the result cache in bytes (defaultResultCacheBudget by default). Once it is used up, storing a result evicts
+		// other results, 0 stores nothing
+		void setResultCacheBudget(size_t bytes);
+
+		size_t numCachedResults();
+
+		// Drops the cached results whose range overlaps [start, end), lookups that are running right now are not cached
+		void invalidateResults(uintptr_t start, uintptr_t end);
+
+		void invalidateResults() { this->invalidateResults(0, UINTPTR_MAX); }
+
+		// Builds an n-gram index over [start, end) on the parallel scan threads. From then on findSignatureInRange answers patterns with
+		// 4 consecutive fully unmasked bytes from the index if the searched range lies within [start, end), so it must not change anymore
+		std::shared_ptr<const NGramIndex> buildIndex(uintptr_t start, uintptr_t end);
+
+		void dropIndexes();
+
+		// Memory ceiling of the search map in bytes (ConcurrentSearchMap::defaultBudget by default), 0 disables caching
+		void setSearchMapBudget(size_t bytes) { searchMap.setBudget(bytes); }
+
+		const ConcurrentSearchMap &getSearchMap() const { return searchMap; }
+
+		// Statistics are off by default, counting costs an atomic add per kernel run and search map lookup while they are on
+		void enableStats(bool enable) { statsEnabled.store(enable, std::memory_order_relaxed); }
+
+		bool areStatsEnabled() const { return statsEnabled.load(std::memory_order_relaxed); }
+
+		ScanStats getStats();
+
+		// Scans that run during the reset may be counted partially
+		void resetStats();
+
+		// Hash of the bytes in [start, end), independent of the address. Tags saved search maps with the content they were built for
+		static uint64_t HashRange(uintptr_t start, uintptr_t end);
+
+		// Writes every search map entry within [rangeStart, rangeEnd) to path, relative to rangeStart.
+		// Returns the number of entries written
+		size_t saveSearchMap(const std::filesystem::path &path, uintptr_t rangeStart, uintptr_t rangeEnd);
+
+		// Merges a search map written by saveSearchMap into this one, rebased on rangeStart.
+		// Returns false without changing anything if the file is missing or malformed, or if the range has different content
+		bool loadSearchMap(const std::filesystem::path &path, uintptr_t rangeStart, uintptr_t rangeEnd);
 	};
 
 }  // namespace MemScanner
\ No newline at end of file
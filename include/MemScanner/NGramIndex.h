@@ -0,0 +1,49 @@
+#pragma once
+
+#include <MemScanner/ThreadPool.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace MemScanner {
+
+	// Sorted table of every 4 byte sequence (4-gram) in a range that does not change, e.g. the .text section of a loaded module.
+	// A pattern with at least 4 consecutive fully unmasked bytes only has to be compared at the positions of its rarest 4-gram.
+	// The memory of the range is read again by every lookup, so it has to stay mapped and unmodified while the index is used
+	class NGramIndex {
+		uintptr_t indexStart = 0, indexEnd = 0;
+		// positions are offsets from indexStart, grouped by the first two bytes of their 4-gram into buckets,
+		// sorted by the last two bytes and then by position within a bucket
+		std::vector<uint32_t> bucketStarts;	 // numBuckets + 1 entries
+		std::vector<uint32_t> positions;
+
+		// [first, last) of the positions of gram
+		std::pair<const uint32_t *, const uint32_t *> candidates(const uint8_t *gram) const;
+
+	public:
+		static constexpr size_t gramSize = 4;
+		static constexpr size_t numBuckets = 1 << 16;
+
+		// Builds the index on the threads of pool (including the calling one) if given.
+		// Throws if the range is larger than 4 GiB
+		NGramIndex(uintptr_t start, uintptr_t end, ThreadPool *pool = nullptr);
+
+		uintptr_t rangeStart() const { return indexStart; }
+
+		uintptr_t rangeEnd() const { return indexEnd; }
+
+		bool covers(uintptr_t start, uintptr_t end) const { return start >= indexStart && end <= indexEnd; }
+
+		// Heap memory used by the index in bytes
+		size_t memoryUsage() const { return (bucketStarts.capacity() + positions.capacity()) * sizeof(uint32_t); }
+
+		// Stores the first (forward) or last match that lies completely within [start, end) in result, nullptr if there is none.
+		// Returns false without a result if the index cannot answer, i.e. the pattern has no 4-gram or the range is not covered
+		template <bool forward>
+		bool find(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, void *&result) const;
+	};
+
+}  // namespace MemScanner
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <MemScanner/MemScanner.h>
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace MemScanner {
+
+	// Scans the memory of another process, results are addresses in that process.
+	// Memory is copied in chunks with process_vm_readv, or from /proc/<pid>/mem if that is not available, and the next chunk is read
+	// while the current one is scanned. Needs ptrace access to the process and is only implemented on linux
+	class RemoteProcess {
+		int pid;
+		int memFd = -1;	 // /proc/<pid>/mem, opened by the first read that falls back to it
+		bool useVmReadv = true;
+		size_t chunkSize;
+		MemScanner scanner;
+
+		// Calls fn(address, data, size) for consecutive chunks of [start, end) that overlap by overlap bytes, from the last one on if !forward.
+		// Every chunk is read while fn runs on the previous one, stops once fn returns true
+		void forEachChunk(uintptr_t start, uintptr_t end, size_t overlap, bool forward, const std::function<bool(uintptr_t, const uint8_t *, size_t)> &fn);
+
+	public:
+		static constexpr size_t defaultChunkSize = 0x100000;
+
+		explicit RemoteProcess(int pid, size_t chunkSize = defaultChunkSize);
+
+		RemoteProcess(const RemoteProcess &) = delete;
+
+		RemoteProcess &operator=(const RemoteProcess &) = delete;
+
+		~RemoteProcess();
+
+		int processId() const { return pid; }
+
+		// Copies [address, address + size) of the process into buffer, throws if any of it cannot be read
+		void read(uintptr_t address, void *buffer, size_t size);
+
+		// First (forward) or last match within [start, end) of the process, 0 if there is none.
+		// The whole range has to be readable, e.g. a mapping from /proc/<pid>/maps
+		template <bool forward>
+		uintptr_t findSignatureInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end);
+
+		template <bool forward>
+		uintptr_t findSignatureInRange(const char *szSignature, uintptr_t start, uintptr_t end);
+
+		// Appends the matches within [start, end) in ascending order, returns how many were added
+		size_t findAllSignaturesInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end,
+										std::vector<uintptr_t> &results, size_t maxMatches = SIZE_MAX);
+	};
+
+}  // namespace MemScanner
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <MemScanner/Anchors.h>
+#include <MemScanner/Macros.h>
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// The compile time kernels live in user translation units that are not built with -mavx2
+#if defined(__GNUC__) || defined(__clang__)
+#define MEM_TARGET_AVX2 __attribute__((target("avx,avx2")))
+#else
+#define MEM_TARGET_AVX2
+#endif
+
+namespace MemScanner {
+
+	// String literal that can be passed as a template argument
+	template <size_t N>
+	struct FixedString {
+		char value[N]{};
+
+		consteval FixedString(const char (&str)[N]) {
+			for (size_t i = 0; i < N; i++) value[i] = str[i];
+		}
+	};
+
+	namespace detail {
+		template <size_t N>
+		struct ParsedFixedSignature {
+			std::array<uint8_t, N> bytes{}, mask{};
+			size_t size = 0;
+		};
+
+		consteval uint8_t ParseHexDigit(char c) {
+			if (c >= '0' && c <= '9') return (uint8_t) (c - '0');
+			if (c >= 'a' && c <= 'f') return (uint8_t) (c - 'a' + 10);
+			if (c >= 'A' && c <= 'F') return (uint8_t) (c - 'A' + 10);
+			throw "malformed signature: invalid hex digit";	 // not a constant expression, reported at compile time
+		}
+
+		consteval bool IsHexDigit(char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+		// Same syntax as MemScanner::ParseSignature, but every byte needs exactly two hex digits or wildcards
+		template <size_t N>
+		consteval ParsedFixedSignature<N> ParseFixedSignature(const FixedString<N> &str) {
+			ParsedFixedSignature<N> parsed{};
+			const char *it = str.value;
+			while (*it) {
+				if (*it == ' ') {
+					it++;
+					continue;
+				}
+
+				uint8_t byte = 0, mask = 0;
+				if (it[0] == '?' && IsHexDigit(it[1])) {
+					byte = ParseHexDigit(it[1]);
+					mask = 0x0F;
+					it += 2;
+				} else if (it[0] == '?') {
+					while (*it == '?') it++;
+				} else {
+					if (it[1] == 0) throw "malformed signature: incomplete byte";
+					byte = (uint8_t) (ParseHexDigit(it[0]) << 4);
+					mask = 0xF0;
+					if (it[1] != '?') {
+						byte |= ParseHexDigit(it[1]);
+						mask = 0xFF;
+					}
+					it += 2;
+				}
+				if (*it == '&') {
+					if (it[1] == 0 || it[2] == 0) throw "malformed signature: incomplete bit mask";
+					mask &= (uint8_t) (ParseHexDigit(it[1]) << 4 | ParseHexDigit(it[2]));
+					it += 3;
+				}
+				parsed.bytes[parsed.size] = byte & mask;
+				parsed.mask[parsed.size] = mask;
+				parsed.size++;
+				if (*it != ' ' && *it != 0) throw "malformed signature: bytes have to be separated by spaces";
+			}
+
+			// Remove trailing ??
+			while (parsed.size > 0 && parsed.mask[parsed.size - 1] == 0) parsed.size--;
+			if (parsed.size == 0) throw "malformed signature: no bytes besides wildcards";
+			return parsed;
+		}
+
+		template <size_t Size, size_t N>
+		consteval std::array<uint8_t, Size> Truncate(const std::array<uint8_t, N> &arr) {
+			std::array<uint8_t, Size> res{};
+			for (size_t i = 0; i < Size; i++) res[i] = arr[i];
+			return res;
+		}
+	}  // namespace detail
+
+	// Signature that is parsed at compile time, e.g. Signature<"48 8B 05 ?? ?? ?? ??">.
+	// Malformed signatures do not compile, the anchors are chosen at compile time as well
+	template <FixedString str>
+	struct Signature {
+	private:
+		static constexpr auto parsed = detail::ParseFixedSignature(str);
+
+	public:
+		static constexpr size_t size = parsed.size;
+		static constexpr std::array<uint8_t, size> bytes = detail::Truncate<size>(parsed.bytes);
+		static constexpr std::array<uint8_t, size> mask = detail::Truncate<size>(parsed.mask);
+		static constexpr PatternAnchors anchors = ComputeAnchors(bytes.data(), mask.data(), size);
+
+		// Compares every unmasked byte, the loop is unrolled and wildcards are dropped at compile time
+		static bool MatchesAt(const uint8_t *p) {
+			return [p]<size_t... I>(std::index_sequence<I...>) {
+				return ((mask[I] == 0 || (uint8_t) (p[I] & mask[I]) == bytes[I]) && ...);
+			}(std::make_index_sequence<size>{});
+		}
+	};
+
+	template <class T>
+	concept CompileTimeSignature = requires {
+		{ T::size } -> std::convertible_to<size_t>;
+		{ T::MatchesAt((const uint8_t *) nullptr) } -> std::same_as<bool>;
+		T::anchors;
+	};
+
+	namespace detail {
+		// All kernels expect start + Sig::size <= end
+		template <CompileTimeSignature Sig, bool forward>
+		void *FindSignatureScalar(uintptr_t rangeStart, uintptr_t rangeEnd) {
+			constexpr auto anchorOffset = Sig::anchors.offsets[0];
+			constexpr uint8_t anchorByte = Sig::bytes[anchorOffset], anchorMask = Sig::mask[anchorOffset];
+			const auto lastStart = rangeEnd - Sig::size;
+
+			if constexpr (forward) {
+				for (auto pCur = rangeStart; pCur <= lastStart; pCur++) {
+					if ((*reinterpret_cast<const uint8_t *>(pCur + anchorOffset) & anchorMask) == anchorByte &&
+						Sig::MatchesAt(reinterpret_cast<const uint8_t *>(pCur)))
+						return reinterpret_cast<void *>(pCur);
+				}
+			} else {
+				for (auto pCur = lastStart + 1; pCur-- > rangeStart;) {
+					if ((*reinterpret_cast<const uint8_t *>(pCur + anchorOffset) & anchorMask) == anchorByte &&
+						Sig::MatchesAt(reinterpret_cast<const uint8_t *>(pCur)))
+						return reinterpret_cast<void *>(pCur);
+				}
+			}
+			return nullptr;
+		}
+
+		// Bit i is set if all anchors match for the start block + i, partially masked anchors are ANDed first
+		template <CompileTimeSignature Sig>
+		inline uint32_t AnchorMatchesSSE2(uintptr_t block) {
+			uint32_t matches = 0xFFFF;
+			for (uint32_t a = 0; a < Sig::anchors.count; a++) {
+				const auto offset = Sig::anchors.offsets[a];
+				const __m128i anchorByte = _mm_set1_epi8((char) Sig::bytes[offset]);												 // SSE2
+				__m128i toBeCompared = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + offset));							 // SSE2
+				if (Sig::mask[offset] != 0xFF) toBeCompared = _mm_and_si128(toBeCompared, _mm_set1_epi8((char) Sig::mask[offset]));	 // SSE2
+				matches &= (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(toBeCompared, anchorByte));									 // SSE2
+			}
+			return matches;
+		}
+
+		template <CompileTimeSignature Sig>
+		MEM_TARGET_AVX2 inline uint32_t AnchorMatchesAVX2(uintptr_t block) {
+			uint32_t matches = 0xFFFFFFFF;
+			for (uint32_t a = 0; a < Sig::anchors.count; a++) {
+				const auto offset = Sig::anchors.offsets[a];
+				const __m256i anchorByte = _mm256_set1_epi8((char) Sig::bytes[offset]);													   // AVX
+				__m256i toBeCompared = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + offset));							   // AVX
+				if (Sig::mask[offset] != 0xFF) toBeCompared = _mm256_and_si256(toBeCompared, _mm256_set1_epi8((char) Sig::mask[offset]));  // AVX2
+				matches &= (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(toBeCompared, anchorByte));								   // AVX2
+			}
+			return matches;
+		}
+
+		template <CompileTimeSignature Sig, bool forward>
+		void *FindSignatureSSE2(uintptr_t rangeStart, uintptr_t rangeEnd) {
+			const auto lastStart = rangeEnd - Sig::size;
+
+			if constexpr (forward) {
+				auto pCur = rangeStart;
+				for (; pCur + 15 <= lastStart; pCur += 16) {
+					auto matches = AnchorMatchesSSE2<Sig>(pCur);
+					if (matches == 0) [[likely]]
+						continue;
+					for (; matches != 0; matches &= matches - 1) {
+						const auto match = pCur + (uintptr_t) std::countr_zero(matches);
+						if (Sig::MatchesAt(reinterpret_cast<const uint8_t *>(match))) return reinterpret_cast<void *>(match);
+					}
+				}
+				return FindSignatureScalar<Sig, true>(pCur, rangeEnd);
+			} else {
+				auto pCur = lastStart;	// the block covers the starts [pCur - 15, pCur]
+				for (; pCur >= rangeStart + 15; pCur -= 16) {
+					auto matches = AnchorMatchesSSE2<Sig>(pCur - 15);
+					if (matches == 0) [[likely]]
+						continue;
+					for (; matches != 0; matches &= ~(0x8000u >> std::countl_zero((uint16_t) matches))) {
+						const auto match = pCur - (uintptr_t) std::countl_zero((uint16_t) matches);
+						if (Sig::MatchesAt(reinterpret_cast<const uint8_t *>(match))) return reinterpret_cast<void *>(match);
+					}
+				}
+				return FindSignatureScalar<Sig, false>(rangeStart, pCur + Sig::size);
+			}
+		}
+
+		template <CompileTimeSignature Sig, bool forward>
+		MEM_TARGET_AVX2 void *FindSignatureAVX2(uintptr_t rangeStart, uintptr_t rangeEnd) {
+			const auto lastStart = rangeEnd - Sig::size;
+
+			if constexpr (forward) {
+				auto pCur = rangeStart;
+				for (; pCur + 31 <= lastStart; pCur += 32) {
+					auto matches = AnchorMatchesAVX2<Sig>(pCur);
+					if (matches == 0) [[likely]]
+						continue;
+					for (; matches != 0; matches &= matches - 1) {
+						const auto match = pCur + (uintptr_t) std::countr_zero(matches);
+						if (Sig::MatchesAt(reinterpret_cast<const uint8_t *>(match))) return reinterpret_cast<void *>(match);
+					}
+				}
+				return FindSignatureScalar<Sig, true>(pCur, rangeEnd);
+			} else {
+				auto pCur = lastStart;	// the block covers the starts [pCur - 31, pCur]
+				for (; pCur >= rangeStart + 31; pCur -= 32) {
+					auto matches = AnchorMatchesAVX2<Sig>(pCur - 31);
+					if (matches == 0) [[likely]]
+						continue;
+					for (; matches != 0; matches &= ~(0x80000000u >> std::countl_zero(matches))) {
+						const auto match = pCur - (uintptr_t) std::countl_zero(matches);
+						if (Sig::MatchesAt(reinterpret_cast<const uint8_t *>(match))) return reinterpret_cast<void *>(match);
+					}
+				}
+				return FindSignatureScalar<Sig, false>(rangeStart, pCur + Sig::size);
+			}
+		}
+	}  // namespace detail
+
+}  // namespace MemScanner
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <MemScanner/MemScanner.h>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace MemScanner {
+
+	// Finds a signature in data that arrives in chunks (sockets, pipes, decompression output) without concatenating them.
+	// Every chunk is scanned in place, only the last size() - 1 bytes of the stream are kept to find matches across chunk borders.
+	// Every match is reported once, by the feed call that delivers its last byte, as the offset from the start of the stream
+	class StreamScanner {
+		MemScanner::Pattern pattern;
+		MemScanner scanner;
+		std::vector<uint8_t> carry;		// the last (up to) size() - 1 bytes fed so far
+		std::vector<uint8_t> junction;	// carry followed by the start of the current chunk
+		std::array<void *, 64> matchBuffer{};
+		uint64_t numFed = 0;
+
+		// Appends the matches that start in [start, end - size()], reported relative to base
+		size_t scan(uintptr_t start, uintptr_t end, uint64_t base, std::vector<uint64_t> &offsets, size_t maxMatches);
+
+	public:
+		explicit StreamScanner(MemScanner::Pattern pattern);
+
+		StreamScanner(std::span<const uint8_t> bytes, std::span<const uint8_t> mask) : StreamScanner(MemScanner::Pattern(bytes, mask)) {}
+
+		explicit StreamScanner(const char *szSignature) : StreamScanner(MemScanner::Pattern(szSignature)) {}
+
+		size_t size() const { return pattern.size(); }
+
+		uint64_t bytesFed() const { return numFed; }
+
+		// Appends the stream offsets of the matches that end within chunk in ascending order, returns how many were added.
+		// With maxMatches the remaining matches of this chunk are dropped, the following chunks are scanned as usual
+		size_t feed(std::span<const uint8_t> chunk, std::vector<uint64_t> &offsets, size_t maxMatches = SIZE_MAX);
+
+		// Starts a new stream at offset 0
+		void reset();
+	};
+
+}  // namespace MemScanner
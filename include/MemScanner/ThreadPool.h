@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MemScanner {
+
+	// Fixed set of worker threads that run one job at a time. The calling thread takes part in every job
+	class ThreadPool {
+		std::mutex runMutex;  // serializes run()
+		std::mutex mutex;
+		std::condition_variable jobReady, jobDone;
+		std::vector<std::thread> workers;
+
+		const std::function<void()> *job = nullptr;
+		uint64_t generation = 0;
+		unsigned int numRequested = 0;	// workers that take part in the current job
+		unsigned int numRunning = 0;	// workers that did not finish the current job yet
+		bool shouldShutdown = false;
+
+		void workerLoop(unsigned int index);
+
+	public:
+		explicit ThreadPool(unsigned int numWorkers);
+
+		ThreadPool(const ThreadPool &) = delete;
+
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		~ThreadPool();
+
+		unsigned int numWorkers() const { return (unsigned int) workers.size(); }
+
+		// Runs job on up to numThreads threads (including the calling one) and returns once all of them returned
+		void run(const std::function<void()> &job, unsigned int numThreads);
+	};
+
+}  // namespace MemScanner
@@ -0,0 +1,218 @@
+#include <MemScanner/FileScanner.h>
+#include <MemScanner/Macros.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MemScanner {
+
+	namespace {
+		size_t MappingGranularity() {
+#ifdef _WIN32
+			SYSTEM_INFO info{};
+			GetSystemInfo(&info);
+			return info.dwAllocationGranularity;
+#else
+			return (size_t) sysconf(_SC_PAGESIZE);
+#endif
+		}
+	}  // namespace
+
+	FileScanner::FileScanner(const std::filesystem::path &path, size_t windowSize) {
+		const auto granularity = MappingGranularity();
+		this->windowSize = (std::max<size_t>(windowSize, 1) + granularity - 1) / granularity * granularity;
+
+#ifdef _WIN32
+		fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE) {
+			fileHandle = nullptr;
+			throw std::runtime_error("could not open file");
+		}
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(fileHandle, &size)) {
+			this->close();
+			throw std::runtime_error("could not get the file size");
+		}
+		fileSize = (uint64_t) size.QuadPart;
+		if (fileSize > 0) {
+			mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mappingHandle == nullptr) {
+				this->close();
+				throw std::runtime_error("could not map file");
+			}
+		}
+#else
+		fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) throw std::runtime_error("could not open file");
+		struct stat info {};
+		if (fstat(fd, &info) != 0) {
+			this->close();
+			throw std::runtime_error("could not get the file size");
+		}
+		fileSize = (uint64_t) info.st_size;
+#endif
+
+		if (fileSize > 0 && fileSize <= this->windowSize) {
+			try {
+				wholeFile = this->mapView(0, (size_t) fileSize, true);
+			} catch (...) {
+				this->close();
+				throw;
+			}
+		}
+	}
+
+	FileScanner::~FileScanner() { this->close(); }
+
+	void FileScanner::close() {
+		if (wholeFile != nullptr) this->unmapView(wholeFile, (size_t) fileSize);
+		wholeFile = nullptr;
+#ifdef _WIN32
+		if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+		if (fileHandle != nullptr) CloseHandle(fileHandle);
+		mappingHandle = fileHandle = nullptr;
+#else
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+#endif
+	}
+
+	const uint8_t *FileScanner::mapView(uint64_t offset, size_t size, bool sequential) {
+#ifdef _WIN32
+		auto *view = MapViewOfFile(mappingHandle, FILE_MAP_READ, (DWORD) (offset >> 32), (DWORD) offset, size);
+		if (view == nullptr) throw std::runtime_error("could not map file");
+		return static_cast<const uint8_t *>(view);
+#else
+		auto *view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, (off_t) offset);
+		if (view == MAP_FAILED) throw std::runtime_error("could not map file");
+		// Read ahead aggressively and drop pages behind the scan early
+		if (sequential) madvise(view, size, MADV_SEQUENTIAL);
+		return static_cast<const uint8_t *>(view);
+#endif
+	}
+
+	void FileScanner::unmapView(const uint8_t *view, size_t size) {
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+#else
+		munmap(const_cast<uint8_t *>(view), size);
+#endif
+	}
+
+	void FileScanner::forEachWindow(size_t overlap, bool forward, const std::function<bool(uint64_t, const uint8_t *, size_t)> &fn) {
+		if (fileSize == 0) return;
+		if (wholeFile != nullptr) {
+			fn(0, wholeFile, (size_t) fileSize);
+			return;
+		}
+
+		// Window k is responsible for the matches that start in [k * windowSize, (k + 1) * windowSize)
+		const auto numWindows = fileSize > overlap ? (fileSize - overlap + windowSize - 1) / windowSize : 1;
+		for (uint64_t i = 0; i < numWindows; i++) {
+			const auto offset = (forward ? i : numWindows - 1 - i) * windowSize;
+			const auto size = (size_t) std::min<uint64_t>(windowSize + overlap, fileSize - offset);
+			const auto *view = this->mapView(offset, size, forward);
+			bool done = false;
+			try {
+				done = fn(offset, view, size);
+			} catch (...) {
+				this->unmapView(view, size);
+				throw;
+			}
+			this->unmapView(view, size);
+			if (done) return;
+		}
+	}
+
+	template <bool forward>
+	uint64_t FileScanner::findSignature(std::span<const uint8_t> bytes, std::span<const uint8_t> mask) {
+		if (bytes.empty() || bytes.size() != mask.size()) throw std::runtime_error("invalid signature size");
+		const auto anchors = MemScanner::SelectAnchors(bytes, mask);
+		uint64_t result = notFound;
+		this->forEachWindow(bytes.size() - 1, forward, [&](uint64_t offset, const uint8_t *data, size_t size) {
+			if (size < bytes.size()) return false;
+			const auto start = reinterpret_cast<uintptr_t>(data);
+			auto *match = scanner.findSignatureFastAVX2<forward>(bytes, mask, anchors, start, start + size);
+			if (match == nullptr) return false;
+			result = offset + (reinterpret_cast<uintptr_t>(match) - start);
+			return true;
+		});
+		return result;
+	}
+
+	template uint64_t FileScanner::findSignature<true>(std::span<const uint8_t>, std::span<const uint8_t>);
+
+	template uint64_t FileScanner::findSignature<false>(std::span<const uint8_t>, std::span<const uint8_t>);
+
+	template <bool forward>
+	uint64_t FileScanner::findSignature(const char *szSignature) {
+		auto [patternBytes, patternMask] = MemScanner::ParseSignature(szSignature);
+		return this->findSignature<forward>(patternBytes, patternMask);
+	}
+
+	template uint64_t FileScanner::findSignature<true>(const char *);
+
+	template uint64_t FileScanner::findSignature<false>(const char *);
+
+	size_t FileScanner::findAllSignatures(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, std::vector<uint64_t> &offsets, size_t maxMatches) {
+		if (bytes.empty() || bytes.size() != mask.size()) throw std::runtime_error("invalid signature size");
+		size_t numFound = 0;
+		std::vector<void *> matches;
+		this->forEachWindow(bytes.size() - 1, true, [&](uint64_t offset, const uint8_t *data, size_t size) {
+			// a match that starts in the overlap does not fit into this window, so every match is reported once
+			if (size < bytes.size()) return false;
+			const auto start = reinterpret_cast<uintptr_t>(data);
+			matches.clear();
+			numFound += scanner.findAllSignaturesInRange(bytes, mask, start, start + size, matches, maxMatches - numFound, false);
+			for (auto *match : matches) offsets.push_back(offset + (reinterpret_cast<uintptr_t>(match) - start));
+			return numFound == maxMatches;
+		});
+		return numFound;
+	}
+
+	std::vector<uint64_t> FileScanner::findSignatures(std::span<const MemScanner::ParsedSignature> patterns) {
+		std::vector<uint64_t> results(patterns.size(), notFound);
+		size_t longest = 0;
+		for (const auto &pattern : patterns) longest = std::max(longest, pattern.first.size());
+		if (patterns.empty() || longest == 0) return results;
+
+		std::vector<size_t> pending(patterns.size());
+		for (size_t i = 0; i < pending.size(); i++) pending[i] = i;
+		std::vector<MemScanner::ParsedSignature> pendingPatterns(patterns.begin(), patterns.end());
+		this->forEachWindow(longest - 1, true, [&](uint64_t offset, const uint8_t *data, size_t size) {
+			const auto start = reinterpret_cast<uintptr_t>(data);
+			const auto found = scanner.findSignaturesInRange(std::span<const MemScanner::ParsedSignature>(pendingPatterns), start, start + size);
+
+			// Patterns with a match are dropped from the following windows
+			size_t numPending = 0;
+			for (size_t i = 0; i < pending.size(); i++) {
+				if (found[i] != nullptr) {
+					results[pending[i]] = offset + (reinterpret_cast<uintptr_t>(found[i]) - start);
+					continue;
+				}
+				pending[numPending] = pending[i];
+				if (numPending != i) pendingPatterns[numPending] = std::move(pendingPatterns[i]);
+				numPending++;
+			}
+			pending.resize(numPending);
+			pendingPatterns.resize(numPending);
+			return numPending == 0;
+		});
+		return results;
+	}
+
+	std::vector<uint64_t> FileScanner::findSignatures(std::span<const char *const> signatures) {
+		std::vector<MemScanner::ParsedSignature> patterns;
+		patterns.reserve(signatures.size());
+		for (const auto *szSignature : signatures) patterns.push_back(MemScanner::ParseSignature(szSignature));
+		return this->findSignatures(std::span<const MemScanner::ParsedSignature>(patterns));
+	}
+
+}  // namespace MemScanner
@@ -4,9 +4,26 @@
 #ifdef _WIN32
 #include <windows.h>
 #include <psapi.h>
+#else
+#include <elf.h>
+#include <link.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 // clang-format on
 
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
 namespace MemScanner {
 
 #ifdef _WIN32
@@ -66,43 +83,313 @@ namespace MemScanner {
 		throw std::runtime_error("section not found");
 	}
 
-	template <bool forward>
-	void *Mem::findSignature(const char *szSignature, bool enableCache, void *module, const char *section) {
-		auto range = Mem::ResolveModuleSection(module, section);
-		return myScanner.findSignatureInRange<forward>(szSignature, range.first, range.second, enableCache);
-	}
+	void *Mem::FindModule(const char *name) { return (void *) GetModuleHandleA(name); }
 
-	template <bool forward>
-	void *Mem::findSignature(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, bool enableCache, void *module, const char *section) {
-		auto range = Mem::ResolveModuleSection(module, section);
-		return myScanner.findSignatureInRange<forward>(bytes, mask, range.first, range.second, enableCache);
+	std::vector<MemoryRegion> Mem::GetMemoryRegions(const RegionFilter &filter) {
+		constexpr DWORD readable = PAGE_READONLY | PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+		constexpr DWORD writable = PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+		constexpr DWORD executable = PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+
+		std::vector<MemoryRegion> regions;
+		MEMORY_BASIC_INFORMATION info{};
+		for (uintptr_t address = 0; VirtualQuery(reinterpret_cast<void *>(address), &info, sizeof(info)) == sizeof(info);) {
+			const auto next = reinterpret_cast<uintptr_t>(info.BaseAddress) + info.RegionSize;
+			if (info.State == MEM_COMMIT && (info.Protect & readable) != 0 && (info.Protect & (PAGE_GUARD | PAGE_NOACCESS)) == 0) {
+				MemoryRegion region;
+				region.start = reinterpret_cast<uintptr_t>(info.BaseAddress);
+				region.end = next;
+				region.writable = (info.Protect & writable) != 0;
+				region.executable = (info.Protect & executable) != 0;
+				if (info.Type == MEM_IMAGE || info.Type == MEM_MAPPED) {
+					char path[MAX_PATH];
+					const auto length = GetMappedFileNameA(GetCurrentProcess(), info.BaseAddress, path, MAX_PATH);
+					if (length > 0) region.path.assign(path, length);
+				}
+				if (filter.accepts(region)) regions.push_back(std::move(region));
+			}
+			if (next <= address) break;
+			address = next;
+		}
+		return regions;
 	}
 
 #else
 
-	std::pair<uint64_t, uint64_t> Mem::GetSectionRange(void *module [[maybe_unused]], const char *name [[maybe_unused]]) {
-		throw std::runtime_error("not implemented");
-		return {};
+	namespace {
+		struct LoadedModule {
+			bool isMain = false;
+			std::string fileName;		   // empty for the main executable
+			uintptr_t start = 0, end = 0;  // spans all loadable segments, the ELF header is at start
+			std::pair<uint64_t, uint64_t> executable{};	 // first executable segment, stands in for .text if the section headers cannot be read
+			std::vector<std::pair<std::string, std::pair<uint64_t, uint64_t>>> sections;
+		};
+
+		// Modules are looked up once, the cache is dropped whenever the loader reports that objects were loaded or unloaded
+		struct ModuleCache {
+			std::mutex mutex;
+			unsigned long long numAdds = 0, numSubs = 0;
+			std::vector<LoadedModule> modules;
+		};
+
+		ModuleCache &GetModuleCache() {
+			static ModuleCache cache;
+			return cache;
+		}
+
+		// Allocated sections from the section header table of the file, which is usually not part of any loaded segment
+		void ReadSectionHeaders(const char *path, uintptr_t loadBias, LoadedModule &module) {
+			std::ifstream file(path, std::ios::binary);
+			ElfW(Ehdr) header{};
+			if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))) return;
+			if (memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 || header.e_shentsize != sizeof(ElfW(Shdr)) || header.e_shoff == 0) return;
+
+			auto readSection = [&](size_t index, ElfW(Shdr) &section) {
+				file.seekg((std::streamoff) (header.e_shoff + index * sizeof(ElfW(Shdr))));
+				return (bool) file.read(reinterpret_cast<char *>(&section), sizeof(section));
+			};
+			// Counts that do not fit into the header are stored in the first section header
+			ElfW(Shdr) first{};
+			if (!readSection(0, first)) return;
+			const size_t numSections = header.e_shnum != 0 ? header.e_shnum : first.sh_size;
+			const size_t namesIndex = header.e_shstrndx != SHN_XINDEX ? header.e_shstrndx : first.sh_link;
+
+			ElfW(Shdr) namesSection{};
+			if (namesIndex >= numSections || !readSection(namesIndex, namesSection)) return;
+			std::string names(namesSection.sh_size, '\0');
+			file.seekg((std::streamoff) namesSection.sh_offset);
+			if (!file.read(names.data(), (std::streamsize) names.size())) return;
+
+			for (size_t i = 1; i < numSections; i++) {
+				ElfW(Shdr) section{};
+				if (!readSection(i, section)) return;
+				if ((section.sh_flags & SHF_ALLOC) == 0 || section.sh_addr == 0 || section.sh_name >= names.size()) continue;
+				const auto start = loadBias + section.sh_addr;
+				module.sections.emplace_back(names.c_str() + section.sh_name, std::make_pair(start, start + section.sh_size));
+			}
+		}
+
+		LoadedModule ParseModule(const dl_phdr_info *info, bool isMain) {
+			LoadedModule module;
+			module.isMain = isMain;
+			if (!isMain && info->dlpi_name != nullptr) module.fileName = std::filesystem::path(info->dlpi_name).filename().string();
+			module.start = UINTPTR_MAX;
+			for (size_t i = 0; i < info->dlpi_phnum; i++) {
+				const auto &segment = info->dlpi_phdr[i];
+				if (segment.p_type != PT_LOAD) continue;
+				const auto start = info->dlpi_addr + segment.p_vaddr;
+				module.start = std::min<uintptr_t>(module.start, start - segment.p_offset);
+				module.end = std::max<uintptr_t>(module.end, start + segment.p_memsz);
+				if ((segment.p_flags & PF_X) != 0 && module.executable.first == 0) module.executable = {start, start + segment.p_memsz};
+			}
+			const char *path = isMain || info->dlpi_name == nullptr || *info->dlpi_name == 0 ? "/proc/self/exe" : info->dlpi_name;
+			ReadSectionHeaders(path, info->dlpi_addr, module);
+			return module;
+		}
+
+		// Whether the file name is name, optionally followed by ".so" and a version suffix like ".6" or ".1.2.3"
+		bool MatchesModuleName(std::string_view fileName, std::string_view name) {
+			if (!fileName.starts_with(name)) return false;
+			auto rest = fileName.substr(name.size());
+			if (rest.starts_with(".so")) rest.remove_prefix(3);
+			while (!rest.empty()) {
+				if (rest.size() < 2 || rest[0] != '.' || !isdigit((unsigned char) rest[1])) return false;
+				rest.remove_prefix(1);
+				while (!rest.empty() && isdigit((unsigned char) rest[0])) rest.remove_prefix(1);
+			}
+			return true;
+		}
+
+		struct FindModuleRequest {
+			uintptr_t address = 0;	// 0 = the main executable
+			const char *name = nullptr;
+			bool isFirst = true;
+			std::optional<LoadedModule> result;
+		};
+
+		int FindModuleCallback(dl_phdr_info *info, size_t, void *data) {
+			auto &request = *static_cast<FindModuleRequest *>(data);
+			const bool isMain = request.isFirst;  // the main program is always reported first
+			request.isFirst = false;
+
+			if (request.name != nullptr) {
+				if (isMain || info->dlpi_name == nullptr) return 0;
+				if (!MatchesModuleName(std::filesystem::path(info->dlpi_name).filename().string(), request.name)) return 0;
+			} else if (request.address != 0) {
+				bool contains = false;
+				for (size_t i = 0; i < info->dlpi_phnum && !contains; i++) {
+					const auto &segment = info->dlpi_phdr[i];
+					const auto start = info->dlpi_addr + segment.p_vaddr;
+					contains = segment.p_type == PT_LOAD && request.address >= start - segment.p_offset && request.address < start + segment.p_memsz;
+				}
+				if (!contains) return 0;
+			} else if (!isMain) {
+				return 0;
+			}
+			request.result = ParseModule(info, isMain);
+			return 1;
+		}
+
+		// Returns the cached module that contains address (nullptr = the main executable) or one whose file name matches name
+		LoadedModule FindLoadedModule(const void *address, const char *name = nullptr) {
+			auto &cache = GetModuleCache();
+			std::lock_guard lock(cache.mutex);
+
+			std::pair<unsigned long long, unsigned long long> counters{};
+			dl_iterate_phdr(
+				[](dl_phdr_info *info, size_t size, void *data) {
+					if (size >= offsetof(dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs))
+						*static_cast<std::pair<unsigned long long, unsigned long long> *>(data) = {info->dlpi_adds, info->dlpi_subs};
+					return 1;
+				},
+				&counters);
+			if (counters.first != cache.numAdds || counters.second != cache.numSubs) {
+				cache.modules.clear();
+				cache.numAdds = counters.first;
+				cache.numSubs = counters.second;
+			}
+
+			const auto addr = reinterpret_cast<uintptr_t>(address);
+			for (const auto &module : cache.modules) {
+				if (name != nullptr ? !module.isMain && MatchesModuleName(module.fileName, name)
+									: addr == 0 ? module.isMain : addr >= module.start && addr < module.end)
+					return module;
+			}
+
+			FindModuleRequest request;
+			request.address = addr;
+			request.name = name;
+			dl_iterate_phdr(FindModuleCallback, &request);
+			if (!request.result) throw std::runtime_error("module not found");
+			if (std::none_of(cache.modules.begin(), cache.modules.end(), [&](const LoadedModule &module) { return module.start == request.result->start; }))
+				cache.modules.push_back(*request.result);
+			return *request.result;
+		}
+	}  // namespace
+
+	std::pair<uint64_t, uint64_t> Mem::GetSectionRange(void *module, const char *name) {
+		const auto loaded = FindLoadedModule(module);
+		for (const auto &[sectionName, range] : loaded.sections)
+			if (sectionName == name) return range;
+		if (loaded.sections.empty() && strcmp(name, ".text") == 0 && loaded.executable.first != 0) return loaded.executable;
+		throw std::runtime_error("section not found");
 	}
 
-	template <bool forward>
-	void *Mem::findSignature(const char *szSignature [[maybe_unused]], bool enableCache [[maybe_unused]], void *module [[maybe_unused]],
-							 const char *section [[maybe_unused]]) {
-		throw std::runtime_error("not implemented");
-		return {};
+	std::pair<uint64_t, uint64_t> Mem::ResolveModuleSection(void *module, const char *section) {
+		if (section == nullptr || *section == 0) {
+			// Entire module
+			const auto loaded = FindLoadedModule(module);
+			return {loaded.start, loaded.end};
+		}
+		return GetSectionRange(module, section);
 	}
 
-	template <bool forward>
-	void *Mem::findSignature(const std::vector<uint8_t> &bytes [[maybe_unused]], const std::vector<uint8_t> &mask [[maybe_unused]],
-							 bool enableCache [[maybe_unused]], void *module [[maybe_unused]], const char *section [[maybe_unused]]) {
-		throw std::runtime_error("not implemented");
-		return {};
+	void *Mem::FindModule(const char *name) {
+		try {
+			return reinterpret_cast<void *>(FindLoadedModule(nullptr, name).start);
+		} catch (const std::runtime_error &) {
+			return nullptr;
+		}
 	}
 
-	std::pair<uint64_t, uint64_t> Mem::ResolveModuleSection(void *module, const char *m) { return {}; }
+	namespace {
+		// Pages of a file mapping that lie completely behind the end of the file raise SIGBUS when they are read.
+		// Returns the end of the readable part, start if nothing is readable or the file could not be looked at
+		uintptr_t ReadableFileMappingEnd(uintptr_t start, uintptr_t end, unsigned long long offset, unsigned long long inode, const std::string &path) {
+			// map_files refers to the mapped file even if it was deleted or replaced, it is not accessible everywhere though
+			char mapFile[64];
+			snprintf(mapFile, sizeof(mapFile), "/proc/self/map_files/%llx-%llx", (unsigned long long) start, (unsigned long long) end);
+			struct stat info {};
+			if (stat(mapFile, &info) != 0 && (stat(path.c_str(), &info) != 0 || info.st_ino != inode)) return start;
+
+			const auto pageSize = (unsigned long long) sysconf(_SC_PAGESIZE);
+			const auto fileEnd = ((unsigned long long) info.st_size + pageSize - 1) & ~(pageSize - 1);
+			if (fileEnd <= offset) return start;
+			return (uintptr_t) std::min<unsigned long long>(end, start + (fileEnd - offset));
+		}
+	}  // namespace
+
+	std::vector<MemoryRegion> Mem::GetMemoryRegions(const RegionFilter &filter) {
+		std::ifstream maps("/proc/self/maps");
+		if (!maps) throw std::runtime_error("could not read /proc/self/maps");
+
+		std::vector<MemoryRegion> regions;
+		std::string line;
+		while (std::getline(maps, line)) {
+			// start-end perms offset dev inode [path]
+			unsigned long long start = 0, end = 0, offset = 0, inode = 0;
+			char perms[5]{};
+			int pathOffset = 0;
+			if (sscanf(line.c_str(), "%llx-%llx %4s %llx %*s %llu %n", &start, &end, perms, &offset, &inode, &pathOffset) < 5 || perms[0] != 'r') continue;
+
+			MemoryRegion region;
+			region.start = (uintptr_t) start;
+			region.end = (uintptr_t) end;
+			region.writable = perms[1] == 'w';
+			region.executable = perms[2] == 'x';
+			if (pathOffset > 0) region.path = line.substr((size_t) pathOffset);
+			if (region.path.starts_with("[vvar") || region.path == "[vsyscall]" || region.path.starts_with("/dev/")) continue;
+			if (inode != 0 && region.isFileBacked()) {
+				region.end = ReadableFileMappingEnd(region.start, region.end, offset, inode, region.path);
+				if (region.end == region.start) continue;
+			}
+			if (filter.accepts(region)) regions.push_back(std::move(region));
+		}
+		return regions;
+	}
 
 #endif
 
+	bool RegionFilter::accepts(const MemoryRegion &region) const {
+		if (writable && *writable != region.writable) return false;
+		if (executable && *executable != region.executable) return false;
+		if (backing != Backing::Any && (backing == Backing::File) != region.isFileBacked()) return false;
+		return pathContains.empty() || region.path.find(pathContains) != std::string::npos;
+	}
+
+	ProcessScanResult Mem::findAllSignaturesInProcess(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const RegionFilter &filter,
+												  size_t maxMatches) {
+		ProcessScanResult result;
+		result.regions = Mem::GetMemoryRegions(filter);
+
+		std::vector<std::pair<uintptr_t, uintptr_t>> ranges;
+		for (const auto &region : result.regions) {
+			if (!ranges.empty() && ranges.back().second == region.start)
+				ranges.back().second = region.end;
+			else
+				ranges.emplace_back(region.start, region.end);
+		}
+
+		std::vector<void *> matches;
+		myScanner.findAllSignaturesInRangesParallel(bytes, mask, ranges, matches, maxMatches);
+		result.matches.reserve(matches.size());
+		for (auto *match : matches) {
+			auto it = std::upper_bound(result.regions.begin(), result.regions.end(), reinterpret_cast<uintptr_t>(match),
+									   [](uintptr_t address, const MemoryRegion &region) { return address < region.start; });
+			result.matches.push_back({match, (size_t) (it - result.regions.begin()) - 1});
+		}
+		return result;
+	}
+
+	ProcessScanResult Mem::findAllSignaturesInProcess(const char *szSignature, const RegionFilter &filter, size_t maxMatches) {
+		auto [patternBytes, patternMask] = MemScanner::ParseSignature(szSignature);
+
+		if (patternMask.empty()) throw std::runtime_error("empty signature after sanitization");
+
+		return this->findAllSignaturesInProcess(patternBytes, patternMask, filter, maxMatches);
+	}
+
+	template <bool forward>
+	void *Mem::findSignature(const char *szSignature, bool enableCache, void *module, const char *section) {
+		auto range = Mem::ResolveModuleSection(module, section);
+		return myScanner.findSignatureInRange<forward>(szSignature, range.first, range.second, enableCache);
+	}
+
+	template <bool forward>
+	void *Mem::findSignature(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, bool enableCache, void *module, const char *section) {
+		auto range = Mem::ResolveModuleSection(module, section);
+		return myScanner.findSignatureInRange<forward>(bytes, mask, range.first, range.second, enableCache);
+	}
+
 	template void *Mem::findSignature<true>(const char *, bool, void *, const char *);
 
 	template void *Mem::findSignature<false>(const char *, bool, void *, const char *);
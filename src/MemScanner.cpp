@@ -1,80 +1,348 @@
 #include <MemScanner/Macros.h>
 #include <MemScanner/MemScanner.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <utility>
 
 namespace MemScanner {
 
-	void MemScanner::addToSearchMap(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t start, uintptr_t end) {
+	size_t MemScanner::ConcurrentSearchMap::SlotIndex(const SearchMapKey &key, size_t capacity) {
+		constexpr uint64_t prime = 0x9E3779B97F4A7C15ull;
+		const auto hash = (key.bytesHash ^ (key.maskHash * prime) ^ key.numBytesUsed) * prime;
+		return (size_t) (hash >> 32) & (capacity - 1);
+	}
+
+	MemScanner::SearchMapKey MemScanner::ConcurrentSearchMap::Slot::loadKey() const {
+		SearchMapKey key;
+		key.bytesHash = bytes.load(std::memory_order_relaxed);
+		key.maskHash = mask.load(std::memory_order_relaxed);
+		key.numBytesUsed = (uint8_t) numBytesUsed.load(std::memory_order_relaxed);
+		return key;
+	}
+
+	void MemScanner::ConcurrentSearchMap::Slot::store(const SearchMapKey &key, const SearchMapValue &value, uint32_t numHits) {
+		const auto seq = sequence.load(std::memory_order_relaxed);
+		sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bytes.store(key.bytesHash, std::memory_order_relaxed);
+		mask.store(key.maskHash, std::memory_order_relaxed);
+		numBytesUsed.store(key.numBytesUsed, std::memory_order_relaxed);
+		start.store(value.start, std::memory_order_relaxed);
+		end.store(value.end, std::memory_order_relaxed);
+		hits.store(numHits, std::memory_order_relaxed);
+		sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	MemScanner::ConcurrentSearchMap::ConcurrentSearchMap() {
+		tables.push_back(std::make_unique<Table>(initialCapacity));
+		table.store(tables.back().get(), std::memory_order_release);
+		setBudget(defaultBudget);
+	}
+
+	bool MemScanner::ConcurrentSearchMap::find(const SearchMapKey &key, SearchMapValue &value) const {
+		const auto &current = *table.load(std::memory_order_acquire);
+		const auto indexMask = current.capacity - 1;
+		for (size_t i = SlotIndex(key, current.capacity), probes = 0; probes < current.capacity; i = (i + 1) & indexMask, probes++) {
+			const auto &slot = current.slots[i];
+			SearchMapKey slotKey;
+			SearchMapValue slotValue;
+			while (true) {
+				const auto seq = slot.sequence.load(std::memory_order_acquire);
+				if (seq & 1) MEM_UNLIKELY {
+						std::this_thread::yield();
+						continue;
+					}
+				slotKey = slot.loadKey();
+				slotValue = slot.loadValue();
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.sequence.load(std::memory_order_relaxed) == seq) break;
+			}
+
+			if (slotKey.numBytesUsed == 0) return false;  // probe sequences end at the first empty slot
+			if (slotKey == key) {
+				// a sampled, plain load and store instead of a locked increment on every hit, a lost hit does not matter.
+				// xorshift32, seeded per thread
+				thread_local uint32_t sampleState = (uint32_t) std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+				sampleState ^= sampleState << 13;
+				sampleState ^= sampleState >> 17;
+				sampleState ^= sampleState << 5;
+				if (sampleState % hitSampleInterval == 0) MEM_UNLIKELY {
+						const auto numHits = slot.hits.load(std::memory_order_relaxed);
+						if (numHits < UINT32_MAX - hitSampleInterval) slot.hits.store(numHits + hitSampleInterval, std::memory_order_relaxed);
+					}
+				value = slotValue;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint32_t MemScanner::ConcurrentSearchMap::numHits(const SearchMapKey &key) {
+		std::lock_guard lock(writeMutex);
+		const auto &current = *tables.back();
+		for (size_t i = SlotIndex(key, current.capacity), probes = 0; probes < current.capacity; i = (i + 1) & (current.capacity - 1), probes++) {
+			const auto &slot = current.slots[i];
+			if (slot.numBytesUsed.load(std::memory_order_relaxed) == 0) break;
+			if (slot.loadKey() == key) return slot.hits.load(std::memory_order_relaxed);
+		}
+		return 0;
+	}
+
+	void MemScanner::ConcurrentSearchMap::PlaceEntry(Table &table, const SearchMapKey &key, const SearchMapValue &value, uint32_t numHits) {
+		auto i = SlotIndex(key, table.capacity);
+		while (table.slots[i].numBytesUsed.load(std::memory_order_relaxed) != 0) i = (i + 1) & (table.capacity - 1);
+		table.slots[i].store(key, value, numHits);
+	}
+
+	void MemScanner::ConcurrentSearchMap::grow() {
+		const auto &old = *tables.back();
+		auto larger = std::make_unique<Table>(old.capacity * 2);
+		for (size_t i = 0; i < old.capacity; i++) {
+			const auto &slot = old.slots[i];
+			if (slot.numBytesUsed.load(std::memory_order_relaxed) != 0)
+				PlaceEntry(*larger, slot.loadKey(), slot.loadValue(), slot.hits.load(std::memory_order_relaxed));
+		}
+		table.store(larger.get(), std::memory_order_release);
+		tables.push_back(std::move(larger));
+		clockHand = 0;
+	}
+
+	void MemScanner::ConcurrentSearchMap::erase(Table &table, size_t index) {
+		const auto indexMask = table.capacity - 1;
+		auto hole = index;
+		for (auto i = (index + 1) & indexMask;; i = (i + 1) & indexMask) {
+			const auto &slot = table.slots[i];
+			const auto key = slot.loadKey();
+			if (key.numBytesUsed == 0) break;
+			// the entry can fill the hole if its home slot is not between the hole and its current slot
+			const auto home = SlotIndex(key, table.capacity);
+			if (((i - home) & indexMask) >= ((i - hole) & indexMask)) {
+				table.slots[hole].store(key, slot.loadValue(), slot.hits.load(std::memory_order_relaxed));
+				hole = i;
+			}
+		}
+		table.slots[hole].store(SearchMapKey(), SearchMapValue(), 0);
+		numEntries.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void MemScanner::ConcurrentSearchMap::evictOne() {
+		auto &current = *tables.back();
+		const auto indexMask = current.capacity - 1;
+
+		// keep hits * narrowing, an entry with a region of width w narrows the search to roughly 2^bit_width(w) bytes
+		auto retention = [](const Slot &slot) {
+			const auto value = slot.loadValue();
+			const auto width = value.end > value.start ? value.end - value.start : 0;
+			return (uint64_t) (slot.hits.load(std::memory_order_relaxed) + 1) * (uint64_t) (65 - std::bit_width(width));
+		};
+
+		const auto numSamples = std::min(numEvictionSamples, numEntries.load(std::memory_order_relaxed));
+		size_t victim = SIZE_MAX;
+		uint64_t victimRetention = UINT64_MAX;
+		for (size_t sampled = 0; sampled < numSamples; clockHand = (clockHand + 1) & indexMask) {
+			const auto &slot = current.slots[clockHand];
+			if (slot.numBytesUsed.load(std::memory_order_relaxed) == 0) continue;
+			sampled++;
+			const auto slotRetention = retention(slot);
+			if (slotRetention < victimRetention) {
+				victim = clockHand;
+				victimRetention = slotRetention;
+			}
+			// age the hits so entries that were hot a long time ago can be evicted eventually
+			slot.hits.store(slot.hits.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+		}
+		erase(current, victim);
+		evictions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool MemScanner::ConcurrentSearchMap::insert(const SearchMapKey &key, const SearchMapValue &value) {
+		std::lock_guard lock(writeMutex);
+		const auto limit = entryLimit.load(std::memory_order_relaxed);
+		if (limit == 0) return false;
+
+		auto *current = tables.back().get();
+		for (size_t i = SlotIndex(key, current->capacity);; i = (i + 1) & (current->capacity - 1)) {
+			auto &slot = current->slots[i];
+			const auto slotKey = slot.loadKey();
+			if (slotKey.numBytesUsed == 0) break;
+			if (slotKey == key) {
+				slot.store(key, value, slot.hits.load(std::memory_order_relaxed));
+				return true;
+			}
+		}
+
+		const auto count = numEntries.load(std::memory_order_relaxed);
+		if (count >= limit)
+			evictOne();
+		else if (count + 1 > current->capacity / 2)
+			grow();
+		PlaceEntry(*tables.back(), key, value, 1);
+		numEntries.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void MemScanner::ConcurrentSearchMap::clear() {
+		std::lock_guard lock(writeMutex);
+		auto &current = *tables.back();
+		for (size_t i = 0; i < current.capacity; i++)
+			if (current.slots[i].numBytesUsed.load(std::memory_order_relaxed) != 0) current.slots[i].store(SearchMapKey(), SearchMapValue(), 0);
+		numEntries.store(0, std::memory_order_relaxed);
+	}
+
+	void MemScanner::ConcurrentSearchMap::setBudget(size_t bytes) {
+		std::lock_guard lock(writeMutex);
+		budget.store(bytes, std::memory_order_relaxed);
+		maxCapacity = bytes / sizeof(Slot) >= 2 ? std::bit_floor(bytes / sizeof(Slot)) : 0;
+		entryLimit.store(maxCapacity / 2, std::memory_order_relaxed);
+		while (numEntries.load(std::memory_order_relaxed) > maxCapacity / 2) evictOne();
+	}
+
+	void MemScanner::addToSearchMap(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end) {
 		if (bytes.size() > 8) return;
-		SearchMapKey key(bytes, mask);
-		SearchMapValue val{start, end};
-		std::lock_guard lock(searchMapMutex);
-		if (searchMap.size() > 2000) return;
-		searchMap[key] = val;
+		searchMap.insert(SearchMapKey(bytes, mask), {start, end});
 	}
 
 	bool MemScanner::findInSearchMap(const SearchMapKey &key, SearchMapValue &region, bool allowAdd, SearchMapValue &originalRegion) {
-		std::shared_lock lock(searchMapMutex);
-
-		auto res = searchMap.find(key);
-		if (res == searchMap.end()) {
+		SearchMapValue val;
+		const bool found = searchMap.find(key, val);
+		this->countStat(found ? SearchMapHits : SearchMapMisses, 1);
+		if (!found) {
 			if (allowAdd) {
-				lock.unlock();
-				std::lock_guard g(needSearchMutex);
-				if (needSearchMap.size() < 200) {
-					for (const auto &[prio, entr] : needSearchMap)
-						if (entr.key == key) return false;	// already in needSearchMap
-					needSearchMap.insert({0, {key, false, originalRegion}});
+				std::unique_lock g(needSearchMutex);
+				auto [iter, inserted] = needSearchKeys.try_emplace(key);
+				if (inserted && needSearchKeys.size() > searchMap.maxEntries()) {
+					needSearchKeys.erase(iter);
+					return false;
 				}
+				auto &state = iter->second;
+				if (inserted) state.regionToBeSearched = originalRegion;
+				state.numRequests++;
+				if (state.isInSearch) return false;
+
+				needSearchHeap.push_back({key, state.numRequests, state.regionToBeSearched.end - state.regionToBeSearched.start});
+				std::push_heap(needSearchHeap.begin(), needSearchHeap.end());
+				if (needSearchHeap.size() > 4 * needSearchKeys.size()) {
+					// mostly outdated entries, rebuild from the current priorities
+					needSearchHeap.clear();
+					for (const auto &[queuedKey, queued] : needSearchKeys)
+						if (!queued.isInSearch)
+							needSearchHeap.push_back({queuedKey, queued.numRequests, queued.regionToBeSearched.end - queued.regionToBeSearched.start});
+					std::make_heap(needSearchHeap.begin(), needSearchHeap.end());
+				}
+				g.unlock();
+				workAvailable.notify_one();
 			}
 			return false;
 		}
 
-		auto &val = res->second;
 		region.start = std::max(region.start, val.start);
 		region.end = std::min(region.end, val.end);
 
 		return true;
 	}
 
-	void MemScanner::getOrAddToSearchMap8Byte(const uint8_t *bytes, const uint8_t *mask, unsigned int size, SearchMapValue &region, bool allowAdd,
-											  SearchMapValue &originalRegion) {
-		// iprnt("prev region: {:X} - {:X}", region.start, region.end);
-
-		for (unsigned int i = 0; i < std::min(8u, size); i++) {
-			if (i > 0 && mask[i] == 0) continue;
-
-			SearchMapKey key(bytes, mask, i + 1);
-			if (!findInSearchMap(key, region, allowAdd, originalRegion)) continue;
+	void MemScanner::getOrAddToSearchMapWindow(const SearchMapWindow &window, SearchMapValue &region, bool allowAdd, SearchMapValue &originalRegion) {
+		for (unsigned int i = 0; i < window.numKeys; i++) {
+			if (!findInSearchMap(window.keys[i], region, allowAdd, originalRegion)) continue;
 			if (region.start > region.end) return;
 		}
-		region.end += size;
-		// iprnt("now region: {:X} - {:X}", region.start, region.end);
 	}
 
-	void MemScanner::getOrAddToSearchMap(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, SearchMapValue &region, bool allowAdd) {
+	template <class WindowAt>
+	void MemScanner::getOrAddToSearchMap(std::span<const uint8_t> mask, WindowAt &&windowAt, SearchMapValue &region, bool allowAdd) {
+		const auto size = mask.size();
 		SearchMapValue originalRegion(region);
-		originalRegion.end += bytes.size();
-		getOrAddToSearchMap8Byte(bytes.data(), mask.data(), (unsigned int) bytes.size(), region, allowAdd, originalRegion);
-		if (bytes.size() <= 8 || region.start >= region.end) return;
-		region.end -= bytes.size();
+		originalRegion.end += size;
+		getOrAddToSearchMapWindow(windowAt(0), region, allowAdd, originalRegion);
+		if (region.start > region.end) return;
+		region.end += size;
+		if (size <= 8 || region.start >= region.end) return;
+		region.end -= size;
 		// try all the permutations
-		for (unsigned int i = 1; i < bytes.size(); i++) {
+		for (unsigned int i = 1; i < size; i++) {
 			if (mask[i] == 0) continue;
 			SearchMapValue tempRegion(region);
-			getOrAddToSearchMap8Byte(bytes.data() + i, mask.data() + i, (unsigned int) bytes.size() - i, tempRegion, allowAdd, originalRegion);
+			getOrAddToSearchMapWindow(windowAt(i), tempRegion, allowAdd, originalRegion);
 			region.start = std::max(region.start, tempRegion.start - i);
 		}
 
-		region.end += bytes.size();
+		region.end += size;
+	}
+
+	void MemScanner::getOrAddToSearchMap(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, SearchMapValue &region, bool allowAdd) {
+		this->getOrAddToSearchMap(
+			mask, [&](size_t offset) { return SearchMapWindow(bytes.data() + offset, mask.data() + offset, bytes.size() - offset); }, region, allowAdd);
 	}
 
+	namespace {
+		std::atomic<uint64_t> nextInstanceId{1};
+	}
+
+	MemScanner::MemScanner() : instanceId(nextInstanceId.fetch_add(1, std::memory_order_relaxed)) {}
+
 	MemScanner::~MemScanner() { this->stopSigRunnerThread(); }
 
+	MemScanner::StatsBlock &MemScanner::threadStats() {
+		thread_local uint64_t cachedInstance = 0;
+		thread_local StatsBlock *cachedBlock = nullptr;
+		if (cachedInstance == instanceId) MEM_LIKELY return *cachedBlock;
+
+		std::lock_guard l(statsMutex);
+		const auto self = std::this_thread::get_id();
+		auto it = std::find_if(statsBlocks.begin(), statsBlocks.end(), [&](const StatsBlock &block) { return block.owner == self; });
+		StatsBlock *block = it != statsBlocks.end() ? &*it : &statsBlocks.emplace_back();
+		block->owner = self;
+		cachedInstance = instanceId;
+		cachedBlock = block;
+		return *block;
+	}
+
+	MemScanner::ScanStats MemScanner::getStats() {
+		std::array<uint64_t, NumStatCounters> sums{};
+		{
+			std::lock_guard l(statsMutex);
+			for (const auto &block : statsBlocks)
+				for (unsigned int i = 0; i < NumStatCounters; i++) sums[i] += block.counters[i].load(std::memory_order_relaxed);
+		}
+
+		ScanStats stats;
+		std::copy(sums.begin(), sums.begin() + ScanStats::NumKernels, stats.bytesScanned.begin());
+		stats.candidates = sums[Candidates];
+		stats.verifiedMatches = sums[VerifiedMatches];
+		stats.searchMapHits = sums[SearchMapHits];
+		stats.searchMapMisses = sums[SearchMapMisses];
+		stats.narrowedScans = sums[NarrowedScans];
+		stats.bytesRequested = sums[BytesRequested];
+		stats.bytesAfterNarrowing = sums[BytesAfterNarrowing];
+		stats.sigRunnerJobs = sums[SigRunnerJobs];
+		stats.sigRunnerBytes = sums[SigRunnerBytes];
+		stats.resultCacheHits = sums[ResultCacheHits];
+		stats.resultCacheMisses = sums[ResultCacheMisses];
+		stats.pendingSearches = this->numPendingSearches();
+		return stats;
+	}
+
+	void MemScanner::resetStats() {
+		std::lock_guard l(statsMutex);
+		for (auto &block : statsBlocks)
+			for (auto &counter : block.counters) counter.store(0, std::memory_order_relaxed);
+	}
+
+	void MemScanner::countNarrowing(uintptr_t start, uintptr_t end, const SearchMapValue &region) {
+		if (!statsEnabled.load(std::memory_order_relaxed)) MEM_LIKELY return;
+		auto &counters = threadStats().counters;
+		counters[NarrowedScans].fetch_add(1, std::memory_order_relaxed);
+		counters[BytesRequested].fetch_add(end > start ? end - start : 0, std::memory_order_relaxed);
+		counters[BytesAfterNarrowing].fetch_add(region.end > region.start ? std::min(region.end - region.start, end - start) : 0, std::memory_order_relaxed);
+	}
+
 	bool hasAvxOSSupport() {
 		// http://stackoverflow.com/a/22521619/922184
 		bool avxSupported = false;
@@ -127,6 +395,37 @@ namespace MemScanner {
 		}
 	}
 
+	bool MemScanner::hasSSE42Support() {
+		static int cached = -1;
+		if (cached != -1) return cached == 1;
+
+		unsigned int info[4]{};
+		cpuid_impl(info, 0, 0);
+		bool sse42 = false;
+		if (info[0] >= 0x00000001) {
+			cpuid_impl(info, 0x00000001, 0);
+			sse42 = (info[2] & ((int) 1 << 20)) != 0;
+		}
+
+		cached = sse42 ? 1 : 0;
+		return sse42;
+	}
+
+	namespace {
+		int hexDigitValue(char c) {
+			if (c >= '0' && c <= '9') return c - '0';
+			if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+			return -1;
+		}
+
+		uint8_t parseHexByte(const char *str) {
+			const auto high = hexDigitValue(str[0]), low = hexDigitValue(str[1]);
+			if (high < 0 || low < 0) throw std::runtime_error("malformed signature");
+			return (uint8_t) (high << 4 | low);
+		}
+	}  // namespace
+
 	std::pair<std::vector<uint8_t>, std::vector<uint8_t>> MemScanner::ParseSignature(const char *szSignature) {
 		std::vector<uint8_t> patternBytes;
 		patternBytes.reserve(strlen(szSignature) / 3 + 1);
@@ -138,23 +437,35 @@ namespace MemScanner {
 
 			if (!*patIt) break;
 
-			if (*patIt == '\?') {
-				if (!patternMask.empty()) {
-					patternBytes.push_back(0);
-					patternMask.push_back(0);
-				}
-
+			uint8_t byt = 0, mask = 0;
+			if (*patIt == '\?' && hexDigitValue(*(patIt + 1)) >= 0) {  // ?5, only the low nibble is compared
+				byt = (uint8_t) hexDigitValue(*(patIt + 1));
+				mask = 0x0F;
+				patIt += 2;
+			} else if (*patIt == '\?') {
 				patIt++;
 				while (*patIt == '\?') patIt++;
-				continue;
+			} else if (*(patIt + 1) == '\?') {	// 4?, only the high nibble is compared
+				if (hexDigitValue(*patIt) < 0) throw std::runtime_error("malformed signature");
+				byt = (uint8_t) (hexDigitValue(*patIt) << 4);
+				mask = 0xF0;
+				patIt += 2;
+			} else {
+				if (!*(patIt + 1)) throw std::runtime_error("malformed signature");	 // wat (second character of hex string is null???)
+				byt = parseHexByte(patIt);
+				mask = 0xFF;
+				patIt += 2;
 			}
 
-			if (!*(patIt + 1)) throw std::runtime_error("malformed signature");	 // wat (second character of hex string is null???)
-			auto byt = strtoul(patIt, nullptr, 16);
-			patternBytes.push_back((uint8_t) (byt & 0xFF));
-			patternMask.push_back(0xFF);
+			// C0&F8 compares the bits set in the explicit mask only
+			if (*patIt == '&') {
+				if (!*(patIt + 1) || !*(patIt + 2)) throw std::runtime_error("malformed signature");
+				mask &= parseHexByte(patIt + 1);
+				patIt += 3;
+			}
 
-			patIt += 2;
+			patternBytes.push_back(byt & mask);
+			patternMask.push_back(mask);
 		}
 		// Remove trailing ??
 		while (!patternMask.empty() && patternMask.back() == 0) {
@@ -165,90 +476,156 @@ namespace MemScanner {
 		return {patternBytes, patternMask};
 	}
 
-	bool MemScanner::doSearchSingleMapKey() {
-		SearchMapKey key;
-		SearchMapValue regionToBeSearched;
-		{
-			std::lock_guard g(needSearchMutex);
-			if (needSearchMap.empty()) return false;
+	PatternAnchors MemScanner::SelectAnchors(std::span<const uint8_t> bytes, std::span<const uint8_t> mask) {
+		return ComputeAnchors(bytes.data(), mask.data(), std::min(bytes.size(), mask.size()));
+	}
 
-			auto iter = needSearchMap.begin();
-			while (iter != needSearchMap.end() && iter->second.isInSearch) iter++;
+	MemScanner::Pattern::Pattern(std::span<const uint8_t> bytes, std::span<const uint8_t> mask) : patternSize(bytes.size()) {
+		if (bytes.empty() || bytes.size() != mask.size()) throw std::runtime_error("invalid signature size");
+		if (std::all_of(mask.begin(), mask.end(), [](uint8_t m) { return m == 0; })) throw std::runtime_error("invalid pattern");
+
+		// bytes and mask share one zero initialized allocation, both start on an alignment boundary
+		const auto padded = this->paddedSize();
+		storage = std::make_unique<uint8_t[]>(2 * padded + alignment - 1);
+		auto *aligned = reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(storage.get()) + alignment - 1) & ~(alignment - 1));
+		for (size_t i = 0; i < patternSize; i++) aligned[i] = bytes[i] & mask[i];
+		std::copy(mask.begin(), mask.end(), aligned + padded);
+		alignedBytes = aligned;
+		alignedMask = aligned + padded;
+
+		patternAnchors = MemScanner::SelectAnchors(this->bytes(), this->mask());
+
+		// the same windows getOrAddToSearchMap would build on every call
+		windows.resize(patternSize > 8 ? patternSize : 1);
+		for (size_t i = 0; i < windows.size(); i++)
+			if (i == 0 || mask[i] != 0) windows[i] = SearchMapWindow(alignedBytes + i, alignedMask + i, patternSize - i);
+	}
 
-			if (iter == needSearchMap.end()) return false;
+	MemScanner::Pattern::Pattern(const Pattern &other) {
+		if (other.patternSize != 0) *this = Pattern(other.bytes(), other.mask());
+	}
 
-			iter->second.isInSearch = true;
+	MemScanner::Pattern &MemScanner::Pattern::operator=(Pattern &&other) noexcept {
+		if (this == &other) return *this;
+		storage = std::move(other.storage);
+		alignedBytes = std::exchange(other.alignedBytes, nullptr);
+		alignedMask = std::exchange(other.alignedMask, nullptr);
+		patternSize = std::exchange(other.patternSize, 0);
+		patternAnchors = std::exchange(other.patternAnchors, {});
+		windows = std::move(other.windows);
+		other.windows.clear();
+		return *this;
+	}
+
+	MemScanner::Pattern::Pattern(const char *szSignature) {
+		auto [patternBytes, patternMask] = MemScanner::ParseSignature(szSignature);
+
+		if (patternMask.empty()) throw std::runtime_error("empty signature after sanitization");
+
+		*this = Pattern(patternBytes, patternMask);
+	}
+
+	bool MemScanner::popSearchJob(SearchMapKey &key, SearchMapValue &regionToBeSearched, uint64_t &generation) {
+		while (!needSearchHeap.empty()) {
+			std::pop_heap(needSearchHeap.begin(), needSearchHeap.end());
+			const auto job = needSearchHeap.back();
+			needSearchHeap.pop_back();
+
+			auto iter = needSearchKeys.find(job.key);
+			if (iter == needSearchKeys.end() || iter->second.isInSearch || iter->second.numRequests != job.numRequests) continue;	// outdated
 
-			key = iter->second.key;
+			// the key stays in needSearchKeys until the search is done, so it is not queued again meanwhile
+			iter->second.isInSearch = true;
+			key = job.key;
 			regionToBeSearched = iter->second.regionToBeSearched;
+			generation = cacheGeneration;
+			return true;
 		}
+		return false;
+	}
 
+	void MemScanner::runSearchJob(const SearchMapKey &key, SearchMapValue regionToBeSearched, uint64_t generation) {
 		SearchMapValue val{regionToBeSearched.start, regionToBeSearched.end - key.numBytesUsed};
-		std::vector<uint8_t> bytes(key.bytes, &key.bytes[key.numBytesUsed]);
-		std::vector<uint8_t> mask(key.mask, &key.mask[key.numBytesUsed]);
+		std::span<const uint8_t> bytes(key.bytes, key.numBytesUsed), mask(key.mask, key.numBytesUsed);
 		getOrAddToSearchMap(bytes, mask, val, false);
-		if (val.start > val.end) goto end;
-
-		{
-			// uintptr_t prevSearchSpace = val.end - val.start;
+		const bool searched = val.start <= val.end;
+		if (searched) {
+			const auto scanFrom = val.start;
 			auto start = reinterpret_cast<uintptr_t>(MemScanner::findSignatureFastAVX2<true>(bytes, mask, val.start, val.end));
-			if (start == 0) {
-				val.start = val.end;
-			} else {
-				val.start = start;
-				// iprnt("reduced search space to {:X} prev: {:X} diff: {:X}", val.end - val.start, prevSearchSpace, prevSearchSpace - (val.end - val.start));
-			}
-			addToSearchMap(bytes, mask, val.start, val.end);
+			val.start = start == 0 ? val.end : start;
+			this->countStat(SigRunnerBytes, val.start - scanFrom);
 		}
+		this->countStat(SigRunnerJobs, 1);
 
-	end:
 		std::lock_guard g(needSearchMutex);
-		auto iter = needSearchMap.begin();
-		while (iter != needSearchMap.end() && iter->second.key != key) iter++;
-		if (iter == needSearchMap.end()) {
-			// dprnt("Key not found back in map!");
-			return true;
+		if (generation != cacheGeneration) return;	// evicted meanwhile, the result may be outdated
+		if (searched) addToSearchMap(bytes, mask, val.start, val.end);
+		needSearchKeys.erase(key);
+	}
+
+	bool MemScanner::doSearchSingleMapKey() {
+		SearchMapKey key;
+		SearchMapValue regionToBeSearched;
+		uint64_t generation = 0;
+		{
+			std::lock_guard g(needSearchMutex);
+			if (!popSearchJob(key, regionToBeSearched, generation)) return false;
 		}
-		needSearchMap.erase(iter);
+		runSearchJob(key, regionToBeSearched, generation);
 		return true;
 	}
 
+	size_t MemScanner::numPendingSearches() {
+		std::lock_guard g(needSearchMutex);
+		return needSearchKeys.size();
+	}
+
 	template <bool forward>
-	void *MemScanner::findSignatureFast1(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart, uintptr_t rangeEnd) {
+	void *MemScanner::findSignatureFast1(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors, uintptr_t rangeStart,
+										 uintptr_t rangeEnd) {
 		const auto patternSize = mask.size();
 		assert(patternSize >= 1);
 		if (rangeStart + bytes.size() > rangeEnd) MEM_UNLIKELY
 		return nullptr;
 		auto *maskStart = mask.data();
 		auto *bytesStart = bytes.data();
-		auto startByte = reinterpret_cast<const uint8_t *>(bytesStart)[0];
-		assert(maskStart[0] != 0);
 		const auto end = rangeEnd - patternSize;
 
+		if (anchors.count == 0) MEM_UNLIKELY  // only wildcards, matches everywhere
+		return reinterpret_cast<void *>(forward ? rangeStart : end);
+		const auto anchorOffset = anchors.offsets[0];
+		const auto anchorMask = maskStart[anchorOffset];
+		const auto anchorByte = (uint8_t) (bytesStart[anchorOffset] & anchorMask);
+
+		uint64_t numCandidates = 0;
 		for (uintptr_t pCur = forward ? rangeStart : end; forward ? (pCur <= end) : (pCur >= rangeStart); forward ? (pCur++) : (pCur--)) {
-			if (*reinterpret_cast<uint8_t *>(pCur) == startByte) MEM_UNLIKELY {
-					unsigned int off = 1;
+			if ((*reinterpret_cast<uint8_t *>(pCur + anchorOffset) & anchorMask) == anchorByte) MEM_UNLIKELY {
+					numCandidates++;
+					unsigned int off = 0;
 
 					for (; off < patternSize; off++) {
-						if (*(uint8_t *) (pCur + off) != bytesStart[off] && maskStart[off] != 0) MEM_LIKELY
+						if (((*(uint8_t *) (pCur + off) ^ bytesStart[off]) & maskStart[off]) != 0) MEM_LIKELY
 						break;
 					}
-					if (off == patternSize) MEM_UNLIKELY
-					return reinterpret_cast<void *>(pCur);
+					if (off == patternSize) MEM_UNLIKELY {
+							this->countScan(ScanStats::Fast1, forward ? pCur - rangeStart + 1 : end - pCur + 1, numCandidates, 1);
+							return reinterpret_cast<void *>(pCur);
+						}
 				}
 		}
 
+		this->countScan(ScanStats::Fast1, end - rangeStart + 1, numCandidates, 0);
 		return nullptr;
 	}
 
-	template void *MemScanner::findSignatureFast1<true>(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart,
-														uintptr_t rangeEnd);
+	template void *MemScanner::findSignatureFast1<true>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors,
+														uintptr_t rangeStart, uintptr_t rangeEnd);
 
-	template void *MemScanner::findSignatureFast1<false>(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart,
-														 uintptr_t rangeEnd);
+	template void *MemScanner::findSignatureFast1<false>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors,
+														 uintptr_t rangeStart, uintptr_t rangeEnd);
 
 	template <bool forward>
-	void *MemScanner::findSignatureFast8(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart, uintptr_t rangeEnd) {
+	void *MemScanner::findSignatureFast8(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t rangeStart, uintptr_t rangeEnd) {
 		if constexpr (!forward) return this->findSignatureFast1<forward>(bytes, mask, rangeStart, rangeEnd);
 		const auto patternSize = mask.size();
 		if (patternSize < 8) return this->findSignatureFast1<forward>(bytes, mask, rangeStart, rangeEnd);
@@ -266,90 +643,815 @@ namespace MemScanner {
 		const auto startByte = reinterpret_cast<const uint64_t *>(bytesStart)[0];
 		const auto end = rangeEnd - patternSize;
 
+		uint64_t numCandidates = 0;
 		for (uintptr_t pCur = rangeStart; pCur <= end; pCur++) {
 			if (*reinterpret_cast<uint64_t *>(pCur) == startByte) MEM_UNLIKELY {
+					numCandidates++;
 					uintptr_t curP = pCur + 8;
 					unsigned int off = 8;
 					for (; off < patternSize; off++) {
-						if (*(uint8_t *) curP != bytesStart[off] && maskStart[off] != 0) MEM_LIKELY
+						if (((*(uint8_t *) curP ^ bytesStart[off]) & maskStart[off]) != 0) MEM_LIKELY
 						break;
 						curP++;
 					}
-					if (off == patternSize) return reinterpret_cast<void *>(pCur);
+					if (off == patternSize) {
+						this->countScan(ScanStats::Fast8, pCur - rangeStart + 1, numCandidates, 1);
+						return reinterpret_cast<void *>(pCur);
+					}
 				}
 		}
 
+		this->countScan(ScanStats::Fast8, end - rangeStart + 1, numCandidates, 0);
 		return nullptr;
 	}
 
-	template void *MemScanner::findSignatureFast8<true>(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart,
+	template void *MemScanner::findSignatureFast8<true>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t rangeStart,
 														uintptr_t rangeEnd);
 
-	template void *MemScanner::findSignatureFast8<false>(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart,
+	template void *MemScanner::findSignatureFast8<false>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t rangeStart,
 														 uintptr_t rangeEnd);
 
-	template <bool forward>
-	void *MemScanner::findSignatureInRange(const std::vector<uint8_t> &patternBytes, const std::vector<uint8_t> &patternMask, uintptr_t start, uintptr_t end,
-										   bool enableCache, bool allowAddToCache) {
+	MemScanner::SearchMapValue MemScanner::prepareSearchRange(std::span<const uint8_t> patternBytes, std::span<const uint8_t> patternMask, uintptr_t start,
+															  uintptr_t end, bool enableCache, bool allowAddToCache) {
 		if (patternBytes.empty() || patternBytes.size() != patternMask.size()) throw std::runtime_error("invalid signature size");
+		if (std::all_of(patternMask.begin(), patternMask.end(), [](uint8_t m) { return m == 0; })) throw std::runtime_error("invalid pattern");
 
 		SearchMapValue val{start, end - patternBytes.size()};
-		if (enableCache)
+		if (enableCache) {
 			this->getOrAddToSearchMap(patternBytes, patternMask, val, allowAddToCache);
-		else
+			this->countNarrowing(start, end, val);
+		} else {
 			val.end += patternBytes.size();
+		}
+		return val;
+	}
+
+	MemScanner::SearchMapValue MemScanner::prepareSearchRange(const Pattern &pattern, uintptr_t start, uintptr_t end, bool enableCache, bool allowAddToCache) {
+		if (pattern.size() == 0) throw std::runtime_error("invalid signature size");	// moved from
+
+		SearchMapValue val{start, end - pattern.size()};
+		if (enableCache) {
+			this->getOrAddToSearchMap(
+				pattern.mask(), [&](size_t offset) -> const SearchMapWindow & { return pattern.searchMapWindows()[offset]; }, val, allowAddToCache);
+			this->countNarrowing(start, end, val);
+		} else {
+			val.end += pattern.size();
+		}
+		return val;
+	}
+
+	template <bool forward>
+	bool MemScanner::findSignatureIndexed(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, void *&result) {
+		if (this->numIndexes.load(std::memory_order_relaxed) == 0) MEM_LIKELY return false;
+
+		std::shared_ptr<const NGramIndex> index;
+		{
+			std::lock_guard l(indexMutex);
+			auto it = std::find_if(indexes.begin(), indexes.end(), [&](const auto &candidate) { return candidate->covers(start, end); });
+			if (it == indexes.end()) return false;
+			index = *it;
+		}
+		return index->find<forward>(bytes, mask, start, end, result);
+	}
+
+	std::shared_ptr<const NGramIndex> MemScanner::buildIndex(uintptr_t start, uintptr_t end) {
+		auto index = std::make_shared<const NGramIndex>(start, end, &this->getScanPool());
+		std::lock_guard l(indexMutex);
+		indexes.push_back(index);
+		numIndexes.store(indexes.size(), std::memory_order_relaxed);
+		return index;
+	}
 
-		if (patternBytes.empty() || patternMask.at(0) == 0) throw std::runtime_error("invalid pattern");
+	void MemScanner::dropIndexes() {
+		std::lock_guard l(indexMutex);
+		indexes.clear();
+		numIndexes.store(0, std::memory_order_relaxed);
+	}
 
+	template <bool forward>
+	void *MemScanner::findSignatureUncached(std::span<const uint8_t> patternBytes, std::span<const uint8_t> patternMask, uintptr_t start, uintptr_t end,
+											bool enableCache, bool allowAddToCache) {
+		void *result;
+		if (this->findSignatureIndexed<forward>(patternBytes, patternMask, start, end, result)) return result;
+		auto val = this->prepareSearchRange(patternBytes, patternMask, start, end, enableCache, allowAddToCache);
 		return this->findSignatureFastAVX2<forward>(patternBytes, patternMask, val.start, val.end);
 	}
 
-	template void *MemScanner::findSignatureInRange<true>(const std::vector<uint8_t> &, const std::vector<uint8_t> &, uintptr_t, uintptr_t, bool, bool);
+	template <bool forward>
+	void *MemScanner::findSignatureInRange(std::span<const uint8_t> patternBytes, std::span<const uint8_t> patternMask, uintptr_t start, uintptr_t end,
+										   bool enableCache, bool allowAddToCache) {
+		auto scan = [&] { return this->findSignatureUncached<forward>(patternBytes, patternMask, start, end, enableCache, allowAddToCache); };
+		if (this->useResultCache(enableCache)) MEM_UNLIKELY {
+				// checked before the probe, an invalid pattern throws instead of being answered from the cache
+				if (patternBytes.empty() || patternBytes.size() != patternMask.size()) throw std::runtime_error("invalid signature size");
+				if (std::all_of(patternMask.begin(), patternMask.end(), [](uint8_t m) { return m == 0; })) throw std::runtime_error("invalid pattern");
+				return this->findSignatureCached<forward>(ResultKeyKind::Pattern, AsChars(patternBytes), AsChars(patternMask), start, end, allowAddToCache,
+														  scan);
+			}
+		return scan();
+	}
+
+	template void *MemScanner::findSignatureInRange<true>(std::span<const uint8_t>, std::span<const uint8_t>, uintptr_t, uintptr_t, bool, bool);
 
-	template void *MemScanner::findSignatureInRange<false>(const std::vector<uint8_t> &, const std::vector<uint8_t> &, uintptr_t, uintptr_t, bool, bool);
+	template void *MemScanner::findSignatureInRange<false>(std::span<const uint8_t>, std::span<const uint8_t>, uintptr_t, uintptr_t, bool, bool);
 
 	template <bool forward>
 	void *MemScanner::findSignatureInRange(const char *szSignature, uintptr_t start, uintptr_t end, bool enableCache, bool allowAddToCache) {
-		auto [patternBytes, patternMask] = MemScanner::ParseSignature(szSignature);
+		auto scan = [&] {
+			auto [patternBytes, patternMask] = MemScanner::ParseSignature(szSignature);
 
-		if (patternMask.empty()) throw std::runtime_error("empty signature after sanitization");
+			if (patternMask.empty()) throw std::runtime_error("empty signature after sanitization");
 
-		return this->findSignatureInRange<forward>(patternBytes, patternMask, start, end, enableCache, allowAddToCache);
+			return this->findSignatureUncached<forward>(patternBytes, patternMask, start, end, enableCache, allowAddToCache);
+		};
+		// Keyed by the text only, so hits are not parsed
+		if (this->useResultCache(enableCache)) MEM_UNLIKELY
+			return this->findSignatureCached<forward>(ResultKeyKind::Text, szSignature, {}, start, end, allowAddToCache, scan);
+		return scan();
 	}
 
 	template void *MemScanner::findSignatureInRange<true>(const char *, uintptr_t, uintptr_t, bool, bool);
 
 	template void *MemScanner::findSignatureInRange<false>(const char *, uintptr_t, uintptr_t, bool, bool);
 
-	void MemScanner::SigRunner(MemScanner *me) {
-		std::unique_lock g(me->shutdownMutex);
+	template <bool forward>
+	void *MemScanner::findSignatureInRange(const Pattern &pattern, uintptr_t start, uintptr_t end, bool enableCache, bool allowAddToCache) {
+		auto scan = [&] {
+			void *result;
+			if (this->findSignatureIndexed<forward>(pattern.bytes(), pattern.mask(), start, end, result)) return result;
+			auto val = this->prepareSearchRange(pattern, start, end, enableCache, allowAddToCache);
+			return this->findSignatureFastAVX2<forward>(pattern.bytes(), pattern.mask(), pattern.anchors(), val.start, val.end);
+		};
+		if (this->useResultCache(enableCache)) MEM_UNLIKELY
+			return this->findSignatureCached<forward>(ResultKeyKind::Pattern, AsChars(pattern.bytes()), AsChars(pattern.mask()), start, end, allowAddToCache,
+													  scan);
+		return scan();
+	}
+
+	template void *MemScanner::findSignatureInRange<true>(const Pattern &, uintptr_t, uintptr_t, bool, bool);
+
+	template void *MemScanner::findSignatureInRange<false>(const Pattern &, uintptr_t, uintptr_t, bool, bool);
+
+	ThreadPool &MemScanner::getScanPool() {
+		std::lock_guard l(scanPoolMutex);
+		if (!scanPool) scanPool = std::make_unique<ThreadPool>(std::max(numScanThreads > 0 ? numScanThreads : std::thread::hardware_concurrency(), 1u) - 1);
+		return *scanPool;
+	}
+
+	void MemScanner::setParallelScanThreads(unsigned int numThreads) {
+		std::lock_guard l(scanPoolMutex);
+		numScanThreads = numThreads;
+		scanPool.reset();
+	}
+
+	template <bool forward>
+	void *MemScanner::findSignatureParallel(std::span<const uint8_t> patternBytes, std::span<const uint8_t> patternMask, const PatternAnchors &anchors,
+											SearchMapValue val) {
+		if (val.start >= val.end || val.end - val.start < parallelScanThreshold)
+			return this->findSignatureFastAVX2<forward>(patternBytes, patternMask, anchors, val.start, val.end);
+
+		auto &pool = this->getScanPool();
+		const auto overlap = patternBytes.size() - 1;
+		const auto numChunks = (val.end - val.start + parallelScanChunkSize - 1) / parallelScanChunkSize;
+		// Chunks are claimed in scan order, so once a match is known every later chunk can be skipped
+		std::atomic<size_t> nextChunk = 0;
+		std::atomic<uintptr_t> best = forward ? UINTPTR_MAX : 0;
+
+		const std::function<void()> job = [&]() {
+			while (true) {
+				const auto chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+				if (chunk >= numChunks) return;
+
+				// [chunkStart, chunkEnd) are the match start addresses this chunk is responsible for
+				const auto chunkStart = val.start + (forward ? chunk : numChunks - 1 - chunk) * parallelScanChunkSize;
+				const auto chunkEnd = std::min(chunkStart + parallelScanChunkSize, val.end);
+				const auto curBest = best.load(std::memory_order_relaxed);
+				if (forward ? chunkStart >= curBest : chunkEnd <= curBest) return;
+
+				auto *result = this->findSignatureFastAVX2<forward>(patternBytes, patternMask, anchors, chunkStart, std::min(chunkEnd + overlap, val.end));
+				if (result == nullptr) continue;
+
+				auto found = reinterpret_cast<uintptr_t>(result);
+				auto expected = best.load(std::memory_order_relaxed);
+				while ((forward ? found < expected : found > expected) && !best.compare_exchange_weak(expected, found, std::memory_order_relaxed)) {
+				}
+			}
+		};
+		pool.run(job, (unsigned int) std::min<size_t>(numChunks, pool.numWorkers() + 1));
+
+		const auto result = best.load();
+		if (result == (forward ? UINTPTR_MAX : 0)) return nullptr;
+		return reinterpret_cast<void *>(result);
+	}
+
+	template <bool forward>
+	void *MemScanner::findSignatureInRangeParallel(std::span<const uint8_t> patternBytes, std::span<const uint8_t> patternMask, uintptr_t start,
+												   uintptr_t end, bool enableCache, bool allowAddToCache) {
+		auto val = this->prepareSearchRange(patternBytes, patternMask, start, end, enableCache, allowAddToCache);
+		return this->findSignatureParallel<forward>(patternBytes, patternMask, MemScanner::SelectAnchors(patternBytes, patternMask), val);
+	}
+
+	template void *MemScanner::findSignatureInRangeParallel<true>(std::span<const uint8_t>, std::span<const uint8_t>, uintptr_t, uintptr_t, bool, bool);
+
+	template void *MemScanner::findSignatureInRangeParallel<false>(std::span<const uint8_t>, std::span<const uint8_t>, uintptr_t, uintptr_t, bool, bool);
+
+	template <bool forward>
+	void *MemScanner::findSignatureInRangeParallel(const char *szSignature, uintptr_t start, uintptr_t end, bool enableCache, bool allowAddToCache) {
+		auto [patternBytes, patternMask] = MemScanner::ParseSignature(szSignature);
+
+		if (patternMask.empty()) throw std::runtime_error("empty signature after sanitization");
+
+		return this->findSignatureInRangeParallel<forward>(patternBytes, patternMask, start, end, enableCache, allowAddToCache);
+	}
+
+	template void *MemScanner::findSignatureInRangeParallel<true>(const char *, uintptr_t, uintptr_t, bool, bool);
+
+	template void *MemScanner::findSignatureInRangeParallel<false>(const char *, uintptr_t, uintptr_t, bool, bool);
+
+	template <bool forward>
+	void *MemScanner::findSignatureInRangeParallel(const Pattern &pattern, uintptr_t start, uintptr_t end, bool enableCache, bool allowAddToCache) {
+		auto val = this->prepareSearchRange(pattern, start, end, enableCache, allowAddToCache);
+		return this->findSignatureParallel<forward>(pattern.bytes(), pattern.mask(), pattern.anchors(), val);
+	}
+
+	template void *MemScanner::findSignatureInRangeParallel<true>(const Pattern &, uintptr_t, uintptr_t, bool, bool);
+
+	template void *MemScanner::findSignatureInRangeParallel<false>(const Pattern &, uintptr_t, uintptr_t, bool, bool);
+
+	MemScanner::MultiPatternTable::MultiPatternTable(std::span<const ParsedSignature> patterns) : patterns(patterns) {
+		for (uint32_t i = 0; i < (uint32_t) patterns.size(); i++) {
+			const auto &[bytes, mask] = patterns[i];
+			if (bytes.empty() || bytes.size() != mask.size()) throw std::runtime_error("invalid signature size");
+
+			// Anchor on the rarest pair of adjacent fully unmasked bytes, or on the rarest such byte if there is no pair
+			if (std::all_of(mask.begin(), mask.end(), [](uint8_t m) { return m == 0; })) throw std::runtime_error("invalid pattern");
+			size_t bestSingle = bytes.size(), bestPair = bytes.size();
+			for (size_t off = 0; off < bytes.size(); off++) {
+				if (mask[off] != 0xFF) continue;
+				if (bestSingle == bytes.size() || x86ByteFrequency[bytes[off]] < x86ByteFrequency[bytes[bestSingle]]) bestSingle = off;
+			}
+			for (size_t off = 0; off + 1 < bytes.size(); off++) {
+				if (mask[off] != 0xFF || mask[off + 1] != 0xFF) continue;
+				if (bestPair == bytes.size() || x86ByteFrequency[bytes[off]] * x86ByteFrequency[bytes[off + 1]] <
+													x86ByteFrequency[bytes[bestPair]] * x86ByteFrequency[bytes[bestPair + 1]])
+					bestPair = off;
+			}
+
+			if (bestPair != bytes.size()) {
+				const auto anchor = (uint16_t) (bytes[bestPair] | (bytes[bestPair + 1] << 8));
+				anchorOffsets.push_back((uint32_t) bestPair);
+				pairAnchors.emplace_back(anchor, i);
+				pairBitmap[anchor >> 6] |= 1ull << (anchor & 63);
+			} else if (bestSingle != bytes.size()) {
+				const auto anchor = bytes[bestSingle];
+				anchorOffsets.push_back((uint32_t) bestSingle);
+				singleAnchors.emplace_back(anchor, i);
+				singleBitmap[anchor >> 6] |= 1ull << (anchor & 63);
+			} else {
+				anchorOffsets.push_back(0);
+				unanchored.push_back(i);
+			}
+		}
+		std::sort(pairAnchors.begin(), pairAnchors.end());
+		std::sort(singleAnchors.begin(), singleAnchors.end());
+
+		// Split the anchors (sorted by first byte) into 8 contiguous buckets, so every bucket only covers a narrow range of first bytes
+		std::vector<std::pair<uint8_t, int>> anchors;  // (first byte, second byte or -1 if masked)
+		anchors.reserve(patterns.size());
+		for (const auto &[anchor, index] : pairAnchors) anchors.emplace_back((uint8_t) (anchor & 0xFF), anchor >> 8);
+		for (const auto &[anchor, index] : singleAnchors) anchors.emplace_back(anchor, -1);
+		std::sort(anchors.begin(), anchors.end());
+		anchors.erase(std::unique(anchors.begin(), anchors.end()), anchors.end());
+		if (anchors.empty()) return;
+
+		for (size_t i = 0; i < anchors.size(); i++) {
+			const auto bucketBit = (uint8_t) (1u << (i * 8 / anchors.size()));
+			const auto [first, second] = anchors[i];
+			lo0[first & 0xF] |= bucketBit;
+			hi0[first >> 4] |= bucketBit;
+			for (int n = 0; n < 16; n++) {
+				if (second == -1 || (second & 0xF) == n) lo1[n] |= bucketBit;
+				if (second == -1 || (second >> 4) == n) hi1[n] |= bucketBit;
+			}
+		}
+
+		// Only worth it if the prefilter rejects most positions, assuming uniformly distributed bytes
+		unsigned int passing = 0;
+		for (unsigned int n = 0; n < 0x10000; n++)
+			if (lo0[n & 0xF] & hi0[(n >> 4) & 0xF] & lo1[(n >> 8) & 0xF] & hi1[n >> 12]) passing++;
+		useNibblePrefilter = passing < 0x10000 / 4;
+	}
+
+	unsigned int MemScanner::MultiPatternTable::verify(uintptr_t p, uintptr_t rangeStart, uintptr_t rangeEnd, std::vector<void *> &results) const {
+		unsigned int found = 0;
+		auto check = [&](uint32_t index) {
+			if (results[index] != nullptr) return;
+			const auto &[bytes, mask] = patterns[index];
+			if (p < rangeStart + anchorOffsets[index]) return;
+			const auto patternStart = p - anchorOffsets[index];
+			if (patternStart + bytes.size() > rangeEnd) return;
+			for (size_t off = 0; off < bytes.size(); off++)
+				if (((*(uint8_t *) (patternStart + off) ^ bytes[off]) & mask[off]) != 0) return;
+			results[index] = reinterpret_cast<void *>(patternStart);
+			found++;
+		};
+
+		const auto firstByte = *reinterpret_cast<const uint8_t *>(p);
+		if (singleBitmap[firstByte >> 6] & (1ull << (firstByte & 63))) {
+			for (auto it = std::lower_bound(singleAnchors.begin(), singleAnchors.end(), std::pair<uint8_t, uint32_t>{firstByte, 0});
+				 it != singleAnchors.end() && it->first == firstByte; it++)
+				check(it->second);
+		}
+		if (p + 1 >= rangeEnd) return found;
+
+		const auto anchor = (uint16_t) (firstByte | (*reinterpret_cast<const uint8_t *>(p + 1) << 8));
+		if (pairBitmap[anchor >> 6] & (1ull << (anchor & 63))) {
+			for (auto it = std::lower_bound(pairAnchors.begin(), pairAnchors.end(), std::pair<uint16_t, uint32_t>{anchor, 0});
+				 it != pairAnchors.end() && it->first == anchor; it++)
+				check(it->second);
+		}
+		return found;
+	}
+
+	unsigned int MemScanner::findSignaturesFast1(const MultiPatternTable &table, uintptr_t rangeStart, uintptr_t rangeEnd, std::vector<void *> &results,
+												 unsigned int remaining, uintptr_t scanFrom) {
+		const auto scanStart = std::max(rangeStart, scanFrom);
+		const auto initiallyRemaining = remaining;
+		uint64_t numCandidates = 0;
+		uintptr_t pCur = scanStart;
+		for (; pCur < rangeEnd && remaining > 0; pCur++) {
+			if (!table.isCandidate(reinterpret_cast<const uint8_t *>(pCur), rangeEnd)) MEM_LIKELY
+			continue;
+			numCandidates++;
+			remaining -= table.verify(pCur, rangeStart, rangeEnd, results);
+		}
+		this->countScan(ScanStats::MultiFast1, pCur > scanStart ? pCur - scanStart : 0, numCandidates, initiallyRemaining - remaining);
+		return remaining;
+	}
+
+	std::vector<void *> MemScanner::findSignaturesInRange(std::span<const ParsedSignature> patterns, uintptr_t start, uintptr_t end) {
+		std::vector<void *> results(patterns.size(), nullptr);
+		if (patterns.empty()) return results;
+
+		MultiPatternTable table(patterns);
+		this->findSignaturesFastAVX2(table, start, end, results, (unsigned int) (patterns.size() - table.unanchored.size()));
+		for (auto index : table.unanchored) {
+			const auto &[bytes, mask] = patterns[index];
+			results[index] = this->findSignatureFastAVX2<true>(bytes, mask, start, end);
+		}
+		return results;
+	}
+
+	std::vector<void *> MemScanner::findSignaturesInRange(std::span<const char *const> signatures, uintptr_t start, uintptr_t end) {
+		std::vector<ParsedSignature> patterns;
+		patterns.reserve(signatures.size());
+		for (const auto *szSignature : signatures) {
+			patterns.push_back(MemScanner::ParseSignature(szSignature));
+			if (patterns.back().second.empty()) throw std::runtime_error("empty signature after sanitization");
+		}
+		return this->findSignaturesInRange(std::span<const ParsedSignature>(patterns), start, end);
+	}
+
+	size_t MemScanner::findAllSignaturesInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end,
+												std::vector<void *> &results, size_t maxMatches, bool enableCache) {
+		auto val = this->prepareSearchRange(bytes, mask, start, end, enableCache, true);
+		ScanCursor cursor(val.start);
+		size_t numFound = 0;
+		while (numFound < maxMatches) {
+			auto *match = this->findNextSignatureFastAVX2(bytes, mask, val.end, cursor);
+			if (match == nullptr) break;
+			results.push_back(match);
+			numFound++;
+		}
+		return numFound;
+	}
 
-		while (!me->shouldShutdown) {
-			if (me->doSearchSingleMapKey()) {
-				std::this_thread::yield();
+	size_t MemScanner::findAllSignaturesInRange(const char *szSignature, uintptr_t start, uintptr_t end, std::vector<void *> &results, size_t maxMatches,
+												bool enableCache) {
+		auto [patternBytes, patternMask] = MemScanner::ParseSignature(szSignature);
+
+		if (patternMask.empty()) throw std::runtime_error("empty signature after sanitization");
+
+		return this->findAllSignaturesInRange(patternBytes, patternMask, start, end, results, maxMatches, enableCache);
+	}
+
+	size_t MemScanner::findAllSignaturesInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, void **out,
+												size_t capacity, bool enableCache) {
+		auto val = this->prepareSearchRange(bytes, mask, start, end, enableCache, true);
+		ScanCursor cursor(val.start);
+		size_t numFound = 0;
+		while (numFound < capacity) {
+			auto *match = this->findNextSignatureFastAVX2(bytes, mask, val.end, cursor);
+			if (match == nullptr) break;
+			out[numFound++] = match;
+		}
+		return numFound;
+	}
+
+	size_t MemScanner::findAllSignaturesInRange(const Pattern &pattern, uintptr_t start, uintptr_t end, void **out, size_t capacity, bool enableCache) {
+		auto val = this->prepareSearchRange(pattern, start, end, enableCache, true);
+		ScanCursor cursor(val.start);
+		cursor.anchors = pattern.anchors();
+		size_t numFound = 0;
+		while (numFound < capacity) {
+			auto *match = this->findNextSignatureFastAVX2(pattern.bytes(), pattern.mask(), val.end, cursor);
+			if (match == nullptr) break;
+			out[numFound++] = match;
+		}
+		return numFound;
+	}
+
+	size_t MemScanner::findAllSignaturesInRangesParallel(std::span<const uint8_t> bytes, std::span<const uint8_t> mask,
+														 std::span<const std::pair<uintptr_t, uintptr_t>> ranges, std::vector<void *> &results,
+														 size_t maxMatches) {
+		if (bytes.empty() || bytes.size() != mask.size()) throw std::runtime_error("invalid signature size");
+		if (std::all_of(mask.begin(), mask.end(), [](uint8_t m) { return m == 0; })) throw std::runtime_error("invalid pattern");
+		if (maxMatches == 0) return 0;
+
+		// [first, second) are the match start addresses a chunk is responsible for, it reads up to overlap bytes further
+		const auto overlap = bytes.size() - 1;
+		std::vector<std::pair<uintptr_t, uintptr_t>> sorted(ranges.begin(), ranges.end()), chunks;
+		std::sort(sorted.begin(), sorted.end());
+		for (const auto &[start, end] : sorted) {
+			if (end <= start || end - start <= overlap) continue;
+			for (auto chunkStart = start; chunkStart < end - overlap; chunkStart += std::min(parallelScanChunkSize, end - overlap - chunkStart)) {
+				chunks.emplace_back(chunkStart, std::min(chunkStart + parallelScanChunkSize, end - overlap));
+			}
+		}
+		if (chunks.empty()) return 0;
+
+		// Chunks are claimed in address order. Once the finished ones hold maxMatches matches, every unclaimed chunk lies behind them
+		std::vector<std::vector<void *>> chunkResults(chunks.size());
+		std::atomic<size_t> nextChunk = 0, numFound = 0;
+		const std::function<void()> job = [&]() {
+			while (numFound.load(std::memory_order_relaxed) < maxMatches) {
+				const auto chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+				if (chunk >= chunks.size()) return;
+				const auto [chunkStart, chunkEnd] = chunks[chunk];
+				const auto count =
+					this->findAllSignaturesInRange(bytes, mask, chunkStart, chunkEnd + overlap, chunkResults[chunk], maxMatches, false);
+				numFound.fetch_add(count, std::memory_order_relaxed);
+			}
+		};
+		auto &pool = this->getScanPool();
+		pool.run(job, (unsigned int) std::min<size_t>(chunks.size(), pool.numWorkers() + 1));
+
+		size_t numAdded = 0;
+		for (const auto &found : chunkResults) {
+			const auto count = std::min(found.size(), maxMatches - numAdded);
+			results.insert(results.end(), found.begin(), found.begin() + (ptrdiff_t) count);
+			numAdded += count;
+		}
+		return numAdded;
+	}
+
+	MemScanner::SignatureMatches MemScanner::iterateSignatureInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start,
+																	 uintptr_t end, size_t maxMatches, bool enableCache) {
+		auto val = this->prepareSearchRange(bytes, mask, start, end, enableCache, true);
+		return {this, {{bytes.begin(), bytes.end()}, {mask.begin(), mask.end()}}, val.start, val.end, maxMatches};
+	}
+
+	MemScanner::SignatureMatches MemScanner::iterateSignatureInRange(const char *szSignature, uintptr_t start, uintptr_t end, size_t maxMatches,
+																	 bool enableCache) {
+		auto pattern = MemScanner::ParseSignature(szSignature);
+
+		if (pattern.second.empty()) throw std::runtime_error("empty signature after sanitization");
+
+		auto val = this->prepareSearchRange(pattern.first, pattern.second, start, end, enableCache, true);
+		return {this, std::move(pattern), val.start, val.end, maxMatches};
+	}
+
+	void MemScanner::SigRunner(MemScanner *me, uint64_t pool) {
+		std::unique_lock g(me->needSearchMutex);
+
+		while (true) {
+			me->workAvailable.wait(g, [me, pool] { return me->sigRunnerPool != pool || !me->asyncJobs.empty() || !me->needSearchHeap.empty(); });
+			if (me->sigRunnerPool != pool) return;
+
+			if (!me->asyncJobs.empty()) {
+				auto job = std::move(me->asyncJobs.front());
+				me->asyncJobs.pop_front();
+				g.unlock();
+				me->runAsyncJob(job);
+				g.lock();
 				continue;
 			}
 
-			me->wakeup.wait_for(g, std::chrono::milliseconds(5));
+			SearchMapKey key;
+			SearchMapValue regionToBeSearched;
+			uint64_t generation = 0;
+			if (!me->popSearchJob(key, regionToBeSearched, generation)) continue;
+
+			g.unlock();
+			me->runSearchJob(key, regionToBeSearched, generation);
+			g.lock();
 		}
 	}
 
-	void MemScanner::startSigRunnerThread() { sigRunnerThread = std::thread(MemScanner::SigRunner, this); }
+	void MemScanner::startSigRunnerThread(unsigned int numWorkers) {
+		if (numWorkers == 0) numWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+
+		std::lock_guard g(needSearchMutex);
+		if (!sigRunnerThreads.empty()) throw std::runtime_error("sig runner threads are already running");
+		for (unsigned int i = 0; i < numWorkers; i++) sigRunnerThreads.emplace_back(MemScanner::SigRunner, this, sigRunnerPool);
+	}
 
 	void MemScanner::stopSigRunnerThread() {
-		std::unique_lock g(shutdownMutex);
-		shouldShutdown = true;
+		std::vector<std::thread> threads;
+		{
+			std::lock_guard g(needSearchMutex);
+			sigRunnerPool++;
+			threads.swap(sigRunnerThreads);
+		}
+		workAvailable.notify_all();
+		for (auto &thread : threads) thread.join();
+
+		std::deque<AsyncJob> leftover;
+		{
+			std::lock_guard g(needSearchMutex);
+			leftover.swap(asyncJobs);
+		}
+		for (auto &job : leftover) this->runAsyncJob(job);
+	}
+
+	void MemScanner::AsyncSignature::State::complete(void *match, std::exception_ptr exception) {
+		std::vector<std::function<void()>> toRun;
+		{
+			std::lock_guard l(mutex);
+			result = match;
+			error = std::move(exception);
+			done = true;
+			toRun.swap(continuations);
+		}
+		finished.notify_all();
+		for (auto &continuation : toRun) continuation();
+	}
+
+	bool MemScanner::AsyncSignature::ready() const {
+		std::lock_guard l(state->mutex);
+		return state->done;
+	}
+
+	void MemScanner::AsyncSignature::wait() const {
+		std::unique_lock l(state->mutex);
+		state->finished.wait(l, [&] { return state->done; });
+	}
+
+	void *MemScanner::AsyncSignature::get() const {
+		this->wait();
+		if (state->error) std::rethrow_exception(state->error);
+		return state->result;
+	}
+
+	void MemScanner::AsyncSignature::then(std::function<void(const AsyncSignature &)> fn) const {
+		{
+			std::lock_guard l(state->mutex);
+			if (!state->done) {
+				state->continuations.emplace_back([self = *this, fn = std::move(fn)] { fn(self); });
+				return;
+			}
+		}
+		fn(*this);
+	}
+
+	bool MemScanner::AsyncSignature::await_suspend(std::coroutine_handle<> handle) const {
+		std::lock_guard l(state->mutex);
+		if (state->done) return false;
+		state->continuations.emplace_back([handle] { handle.resume(); });
+		return true;
+	}
+
+	void MemScanner::runAsyncJob(AsyncJob &job) {
+		void *result = nullptr;
+		std::exception_ptr error;
+		try {
+			result = job.forward ? this->findSignatureInRange<true>(job.bytes, job.mask, job.start, job.end, job.enableCache)
+								 : this->findSignatureInRange<false>(job.bytes, job.mask, job.start, job.end, job.enableCache);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		{
+			// From here on identical requests start a new lookup
+			std::lock_guard g(needSearchMutex);
+			asyncInFlight.erase(job.key);
+		}
+		job.state->complete(result, std::move(error));
+	}
+
+	template <bool forward>
+	MemScanner::AsyncSignature MemScanner::findSignatureInRangeAsync(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start,
+																	  uintptr_t end, bool enableCache) {
+		if (bytes.empty() || bytes.size() != mask.size()) throw std::runtime_error("invalid signature size");
+		if (std::all_of(mask.begin(), mask.end(), [](uint8_t m) { return m == 0; })) throw std::runtime_error("invalid pattern");
+
+		const uintptr_t header[] = {start, end, (uintptr_t) forward | (uintptr_t) enableCache << 1};
+		std::string key(reinterpret_cast<const char *>(header), sizeof(header));
+		key.append(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+		key.append(reinterpret_cast<const char *>(mask.data()), mask.size());
+
+		std::unique_lock g(needSearchMutex);
+		auto [iter, inserted] = asyncInFlight.try_emplace(key);
+		if (!inserted) return AsyncSignature(iter->second);
+
+		iter->second = std::make_shared<AsyncSignature::State>();
+		AsyncJob job{key, {bytes.begin(), bytes.end()}, {mask.begin(), mask.end()}, start, end, forward, enableCache, iter->second};
+		AsyncSignature handle(iter->second);
+		if (sigRunnerThreads.empty()) {
+			// Identical requests from other threads still share this lookup while it runs
+			g.unlock();
+			this->runAsyncJob(job);
+			return handle;
+		}
+		asyncJobs.push_back(std::move(job));
 		g.unlock();
-		wakeup.notify_all();
-		if (sigRunnerThread.joinable()) sigRunnerThread.join();
+		workAvailable.notify_one();
+		return handle;
 	}
 
+	template MemScanner::AsyncSignature MemScanner::findSignatureInRangeAsync<true>(std::span<const uint8_t>, std::span<const uint8_t>, uintptr_t,
+																					 uintptr_t, bool);
+
+	template MemScanner::AsyncSignature MemScanner::findSignatureInRangeAsync<false>(std::span<const uint8_t>, std::span<const uint8_t>, uintptr_t,
+																					  uintptr_t, bool);
+
+	template <bool forward>
+	MemScanner::AsyncSignature MemScanner::findSignatureInRangeAsync(const char *szSignature, uintptr_t start, uintptr_t end, bool enableCache) {
+		auto [patternBytes, patternMask] = MemScanner::ParseSignature(szSignature);
+
+		if (patternMask.empty()) throw std::runtime_error("empty signature after sanitization");
+
+		return this->findSignatureInRangeAsync<forward>(patternBytes, patternMask, start, end, enableCache);
+	}
+
+	template MemScanner::AsyncSignature MemScanner::findSignatureInRangeAsync<true>(const char *, uintptr_t, uintptr_t, bool);
+
+	template MemScanner::AsyncSignature MemScanner::findSignatureInRangeAsync<false>(const char *, uintptr_t, uintptr_t, bool);
+
 	void MemScanner::evictCache() {
-		std::unique_lock g(this->shutdownMutex);
-		std::lock_guard l1(searchMapMutex);
-		std::lock_guard l2(this->needSearchMutex);
-		this->searchMap.clear();
-		this->needSearchMap.clear();
+		{
+			std::lock_guard g(this->needSearchMutex);
+			this->cacheGeneration++;
+			this->searchMap.clear();
+			this->needSearchHeap.clear();
+			this->needSearchKeys.clear();
+		}
+		this->invalidateResults();
+	}
+
+	void MemScanner::ResultKey(std::string &key, ResultKeyKind kind, bool forward, std::string_view signature, std::string_view mask, uintptr_t start,
+							   uintptr_t end) {
+		const uintptr_t header[] = {start, end, (uintptr_t) forward | (uintptr_t) kind << 1};
+		key.assign(reinterpret_cast<const char *>(header), sizeof(header));
+		key.append(signature);
+		key.append(mask);
+	}
+
+	bool MemScanner::findCachedResult(const std::string &key, void *&result, uint64_t &generation) {
+		std::shared_lock l(resultCacheMutex);
+		auto it = resultCache.find(key);
+		const bool hit = it != resultCache.end();
+		if (hit) {
+			result = it->second;
+		} else {
+			generation = resultGeneration;
+		}
+		l.unlock();
+		this->countStat(hit ? ResultCacheHits : ResultCacheMisses, 1);
+		return hit;
+	}
+
+	void MemScanner::evictResult() {
+		if (resultCache.empty()) return;
+		// The map has no order, taking the entries of the buckets in turn evicts about at random
+		const auto numBuckets = resultCache.bucket_count();
+		while (resultCache.bucket_size(resultEvictionHand % numBuckets) == 0) resultEvictionHand++;
+		const std::string victim = resultCache.begin(resultEvictionHand % numBuckets)->first;
+		resultCacheBytes -= ResultEntrySize(victim);
+		resultCache.erase(victim);
+	}
+
+	void MemScanner::storeResult(const std::string &key, void *result, uint64_t generation) {
+		std::lock_guard l(resultCacheMutex);
+		// The range may have changed while it was scanned, or the cache was disabled meanwhile
+		if (generation != resultGeneration || !this->isResultCacheEnabled()) return;
+		const auto size = ResultEntrySize(key);
+		if (size > resultCacheBudget) return;
+		if (!resultCache.contains(key)) {
+			while (resultCacheBytes + size > resultCacheBudget) this->evictResult();
+			resultCacheBytes += size;
+		}
+		resultCache.insert_or_assign(key, result);
+	}
+
+	void MemScanner::enableResultCache(bool enable) {
+		std::lock_guard l(resultCacheMutex);
+		resultCacheEnabled.store(enable, std::memory_order_relaxed);
+		if (!enable) {
+			resultGeneration++;
+			resultCache.clear();
+			resultCacheBytes = 0;
+		}
+	}
+
+	void MemScanner::setResultCacheBudget(size_t bytes) {
+		std::lock_guard l(resultCacheMutex);
+		resultCacheBudget = bytes;
+		while (resultCacheBytes > resultCacheBudget) this->evictResult();
+	}
+
+	size_t MemScanner::numCachedResults() {
+		std::shared_lock l(resultCacheMutex);
+		return resultCache.size();
+	}
+
+	void MemScanner::invalidateResults(uintptr_t start, uintptr_t end) {
+		std::lock_guard l(resultCacheMutex);
+		resultGeneration++;
+		std::erase_if(resultCache, [&](const auto &entry) {
+			uintptr_t range[2];
+			std::memcpy(range, entry.first.data(), sizeof(range));
+			if (range[0] >= end || start >= range[1]) return false;
+			resultCacheBytes -= ResultEntrySize(entry.first);
+			return true;
+		});
+	}
+
+	namespace {
+		constexpr char searchMapMagic[8] = {'M', 'S', 'C', 'A', 'C', 'H', 'E', 0};
+	}
+
+	uint64_t MemScanner::HashRange(uintptr_t start, uintptr_t end) {
+		// Independent multiply-xorshift lanes keep the multiplier busy, hashing runs at several GB/s
+		constexpr uint64_t prime = 0x9E3779B97F4A7C15ull;
+		const uint64_t size = end - start;
+		uint64_t lanes[4] = {size, size + 1, size + 2, size + 3};
+
+		auto pCur = start;
+		for (; pCur + 32 <= end; pCur += 32) {
+			for (int l = 0; l < 4; l++) {
+				uint64_t word;
+				memcpy(&word, reinterpret_cast<const void *>(pCur + l * 8), sizeof(word));
+				lanes[l] = (lanes[l] ^ word) * prime;
+				lanes[l] ^= lanes[l] >> 29;
+			}
+		}
+		uint64_t hash = 0;
+		for (auto lane : lanes) hash = (hash ^ lane) * prime;
+		for (; pCur < end; pCur++) hash = (hash ^ *reinterpret_cast<const uint8_t *>(pCur)) * prime;
+		return hash ^ (hash >> 32);
+	}
+
+	size_t MemScanner::saveSearchMap(const std::filesystem::path &path, uintptr_t rangeStart, uintptr_t rangeEnd) {
+		std::vector<SearchMapFileEntry> entries;
+		entries.reserve(searchMap.size());
+		searchMap.forEach([&](const SearchMapKey &key, const SearchMapValue &val) {
+			if (val.start < rangeStart || val.end > rangeEnd || val.start > val.end) return;
+			entries.push_back({key.bytesHash, key.maskHash, key.numBytesUsed, val.start - rangeStart, val.end - rangeStart});
+		});
+
+		SearchMapFileHeader header{};
+		memcpy(header.magic, searchMapMagic, sizeof(header.magic));
+		header.version = SearchMapFileHeader::currentVersion;
+		header.numEntries = (uint32_t) entries.size();
+		header.rangeSize = rangeEnd - rangeStart;
+		header.contentHash = MemScanner::HashRange(rangeStart, rangeEnd);
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char *>(entries.data()), (std::streamsize) (entries.size() * sizeof(SearchMapFileEntry)));
+		if (!file) throw std::runtime_error("could not write search map");
+		return entries.size();
+	}
+
+	bool MemScanner::loadSearchMap(const std::filesystem::path &path, uintptr_t rangeStart, uintptr_t rangeEnd) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return false;
+
+		SearchMapFileHeader header{};
+		if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))) return false;
+		if (memcmp(header.magic, searchMapMagic, sizeof(header.magic)) != 0 || header.version != SearchMapFileHeader::currentVersion) return false;
+		if (header.rangeSize != rangeEnd - rangeStart || header.contentHash != MemScanner::HashRange(rangeStart, rangeEnd)) return false;
+
+		// The count is checked against the file before anything is allocated for it
+		const auto entriesStart = file.tellg();
+		file.seekg(0, std::ios::end);
+		const auto fileEnd = file.tellg();
+		if (entriesStart < 0 || fileEnd < entriesStart || (uint64_t) (fileEnd - entriesStart) / sizeof(SearchMapFileEntry) < header.numEntries) return false;
+		file.seekg(entriesStart);
+
+		std::vector<SearchMapFileEntry> entries(header.numEntries);
+		if (!file.read(reinterpret_cast<char *>(entries.data()), (std::streamsize) (entries.size() * sizeof(SearchMapFileEntry)))) return false;
+		for (const auto &entry : entries)
+			if (entry.numBytesUsed == 0 || entry.numBytesUsed > 8 || entry.startOffset > entry.endOffset || entry.endOffset > header.rangeSize) return false;
+
+		for (const auto &entry : entries) {
+			SearchMapKey key;
+			key.bytesHash = entry.bytes;
+			key.maskHash = entry.mask;
+			key.numBytesUsed = (uint8_t) entry.numBytesUsed;
+			if (!searchMap.insert(key, {rangeStart + entry.startOffset, rangeStart + entry.endOffset})) break;
+		}
+		return true;
 	}
 
 }  // namespace MemScanner
\ No newline at end of file
@@ -1,109 +1,392 @@
 #include <MemScanner/Macros.h>
 #include <MemScanner/MemScanner.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 namespace MemScanner {
+	namespace {
+		// Verifies the candidates that passed the anchors. The filter window of the anchors rejects most of them with a single compare,
+		// the pattern is then compared 32 bytes (16 for patterns shorter than 32) at a time against the masked pattern blocks.
+		// Patterns shorter than 16 bytes are compared byte by byte
+		class CandidateVerifier {
+			static constexpr unsigned int maxBlocks = 8;  // bytes behind maxBlocks * 32 are compared one by one
+
+			const uint8_t *bytes, *mask;
+			unsigned int patternSize, numBlocks = 0, scalarStart = 0;
+			uint32_t filterOffset, filterSize;
+			uint64_t filterBytes, filterMask;
+			unsigned int blockOffsets[maxBlocks]{};
+			__m256i blockBytes[maxBlocks], blockMasks[maxBlocks];
+			bool halfBlocks = false;  // two 16 byte blocks instead
+			__m128i halfBytes[2], halfMasks[2];
+
+		public:
+			CandidateVerifier(const uint8_t *bytes, const uint8_t *mask, unsigned int patternSize, const PatternAnchors &anchors)
+				: bytes(bytes),
+				  mask(mask),
+				  patternSize(patternSize),
+				  filterOffset(anchors.filterOffset),
+				  filterSize(anchors.filterSize),
+				  filterBytes(anchors.filterBytes),
+				  filterMask(anchors.filterMask) {
+				// A candidate may lie in the last 32 bytes of the range, so no load may reach past the pattern.
+				// The last block overlaps the one before it instead of being padded
+				if (patternSize < 16) return;
+				if (patternSize < 32) {
+					halfBlocks = true;
+					for (unsigned int b = 0; b < 2; b++) {
+						const auto offset = b * (patternSize - 16);
+						halfMasks[b] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask + offset));											 // SSE2
+						halfBytes[b] = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + offset)), halfMasks[b]);	 // SSE2
+					}
+					scalarStart = patternSize;
+					return;
+				}
+				numBlocks = std::min((patternSize + 31) / 32, maxBlocks);
+				for (unsigned int b = 0; b < numBlocks; b++) {
+					blockOffsets[b] = std::min(b * 32, patternSize - 32);
+					blockMasks[b] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + blockOffsets[b]));  // AVX
+					blockBytes[b] =
+						_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + blockOffsets[b])), blockMasks[b]);	 // AVX, AVX2
+				}
+				scalarStart = std::min(patternSize, maxBlocks * 32);
+			}
+
+			bool operator()(const uint8_t *candidate) const {
+				if (filterSize == 8) {
+					uint64_t window;
+					memcpy(&window, candidate + filterOffset, sizeof(window));
+					if ((window & filterMask) != filterBytes) MEM_LIKELY
+					return false;
+				} else if (filterSize == 4) {
+					uint32_t window;
+					memcpy(&window, candidate + filterOffset, sizeof(window));
+					if ((window & (uint32_t) filterMask) != (uint32_t) filterBytes) MEM_LIKELY
+					return false;
+				}
+
+				if (halfBlocks) {
+					const auto *lastStart = candidate + patternSize - 16;
+					const __m128i first = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(candidate)), halfMasks[0]);	 // SSE2
+					const __m128i last = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lastStart)), halfMasks[1]);	 // SSE2
+					const __m128i equal = _mm_and_si128(_mm_cmpeq_epi8(first, halfBytes[0]), _mm_cmpeq_epi8(last, halfBytes[1]));		 // SSE2
+					return _mm_movemask_epi8(equal) == 0xFFFF;																			 // SSE2
+				}
+				for (unsigned int b = 0; b < numBlocks; b++) {
+					const __m256i memory = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(candidate + blockOffsets[b]));  // AVX
+					const __m256i masked = _mm256_and_si256(memory, blockMasks[b]);											 // AVX2
+					if ((unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(masked, blockBytes[b])) != 0xFFFFFFFFu) return false;	 // AVX2
+				}
+				for (unsigned int off = scalarStart; off < patternSize; off++) {
+					if (((candidate[off] ^ bytes[off]) & mask[off]) != 0) MEM_LIKELY
+					return false;
+				}
+				return true;
+			}
+		};
+
+		// Scans 32 candidate positions per iteration, a position is only verified if all anchors match.
+		// Partially masked anchors are ANDed with their mask before the compare.
+		// pCur is the first block, it is left at the first position that was not scanned (forward) or the lowest scanned position (backward)
+		template <unsigned int numAnchors, bool partialAnchors, bool forward>
+		void *scanBlocksAVX2(const uint8_t *bytes, const uint8_t *mask, const CandidateVerifier &verify, const PatternAnchors &anchors, uintptr_t &pCur,
+							 uintptr_t limit, uint64_t &numCandidates) {
+			uint64_t candidates = 0;  // counted locally, a counter behind a reference would be stored again before every byte read
+			__m256i anchorBytes[numAnchors], anchorMasks[numAnchors];
+			for (unsigned int a = 0; a < numAnchors; a++) {
+				const auto offset = anchors.offsets[a];
+				anchorBytes[a] = _mm256_set1_epi8((char) (bytes[offset] & mask[offset]));  // AVX
+				anchorMasks[a] = _mm256_set1_epi8((char) mask[offset]);					   // AVX
+			}
+
+			while (forward ? (pCur <= limit) : true) {
+				auto matches = 0xFFFFFFFFu;
+				for (unsigned int a = 0; a < numAnchors; a++) {
+					__m256i toBeCompared = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pCur + anchors.offsets[a]));  // AVX
+					if constexpr (partialAnchors) toBeCompared = _mm256_and_si256(toBeCompared, anchorMasks[a]);			  // AVX2
+					matches &= (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(toBeCompared, anchorBytes[a]));		  // AVX2
+				}
+
+				unsigned long curBit = 0;
+				while (forward ? bitscanforward(&curBit, matches) : bitscanreverse(&curBit, matches)) {
+					candidates++;
+					if (verify(reinterpret_cast<const uint8_t *>(pCur + curBit))) MEM_UNLIKELY {
+							numCandidates = candidates;
+							return reinterpret_cast<void *>(pCur + curBit);
+						}
+
+					matches = forward ? _blsr_u32(matches) : (matches & ~(1u << curBit));
+				}
+
+				if constexpr (forward) {
+					pCur += 32;
+				} else {
+					if (pCur < limit + 32) break;
+					pCur -= 32;
+				}
+			}
+			numCandidates = candidates;
+			return nullptr;
+		}
+
+		// memchr for patterns of one or two bytes. The anchors cover every byte that is not a wildcard, so an anchor match is a match.
+		// 128 starts per iteration while four blocks fit, pCur is left like in scanBlocksAVX2
+		template <unsigned int numAnchors, bool partialAnchors, bool forward>
+		void *scanShortAVX2(const uint8_t *bytes, const uint8_t *mask, const PatternAnchors &anchors, uintptr_t &pCur, uintptr_t limit) {
+			__m256i anchorBytes[numAnchors], anchorMasks[numAnchors];
+			for (unsigned int a = 0; a < numAnchors; a++) {
+				const auto offset = anchors.offsets[a];
+				anchorBytes[a] = _mm256_set1_epi8((char) (bytes[offset] & mask[offset]));  // AVX
+				anchorMasks[a] = _mm256_set1_epi8((char) mask[offset]);					   // AVX
+			}
+			auto blockEqual = [&](uintptr_t block) {
+				__m256i equal = _mm256_set1_epi8((char) 0xFF);	// AVX
+				for (unsigned int a = 0; a < numAnchors; a++) {
+					__m256i toBeCompared = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + anchors.offsets[a]));  // AVX
+					if constexpr (partialAnchors) toBeCompared = _mm256_and_si256(toBeCompared, anchorMasks[a]);			   // AVX2
+					equal = _mm256_and_si256(equal, _mm256_cmpeq_epi8(toBeCompared, anchorBytes[a]));						   // AVX2
+				}
+				return equal;
+			};
+
+			// Four blocks are tested at once, the matches are only extracted from a group that has any
+			unsigned long curBit = 0;
+			if constexpr (forward) {
+				for (; pCur + 96 <= limit; pCur += 128) {
+					const __m256i equal[4] = {blockEqual(pCur), blockEqual(pCur + 32), blockEqual(pCur + 64), blockEqual(pCur + 96)};
+					const __m256i any = _mm256_or_si256(_mm256_or_si256(equal[0], equal[1]), _mm256_or_si256(equal[2], equal[3]));  // AVX2
+					if (_mm256_testz_si256(any, any)) MEM_LIKELY  // AVX
+					continue;
+					for (unsigned int b = 0; b < 4; b++) {
+						if (bitscanforward(&curBit, (unsigned int) _mm256_movemask_epi8(equal[b])))  // AVX2
+							return reinterpret_cast<void *>(pCur + 32 * b + curBit);
+					}
+				}
+				for (; pCur <= limit; pCur += 32) {
+					if (bitscanforward(&curBit, (unsigned int) _mm256_movemask_epi8(blockEqual(pCur))))	// AVX2
+						return reinterpret_cast<void *>(pCur + curBit);
+				}
+			} else {
+				while (pCur >= limit + 96) {
+					const __m256i equal[4] = {blockEqual(pCur), blockEqual(pCur - 32), blockEqual(pCur - 64), blockEqual(pCur - 96)};
+					const __m256i any = _mm256_or_si256(_mm256_or_si256(equal[0], equal[1]), _mm256_or_si256(equal[2], equal[3]));  // AVX2
+					if (!_mm256_testz_si256(any, any)) MEM_UNLIKELY {  // AVX
+							for (unsigned int b = 0; b < 4; b++) {
+								if (bitscanreverse(&curBit, (unsigned int) _mm256_movemask_epi8(equal[b])))	// AVX2
+									return reinterpret_cast<void *>(pCur - 32 * b + curBit);
+							}
+						}
+					pCur -= 96;
+					if (pCur < limit + 32) return nullptr;
+					pCur -= 32;
+				}
+				while (true) {
+					if (bitscanreverse(&curBit, (unsigned int) _mm256_movemask_epi8(blockEqual(pCur))))  // AVX2
+						return reinterpret_cast<void *>(pCur + curBit);
+					if (pCur < limit + 32) break;
+					pCur -= 32;
+				}
+			}
+			return nullptr;
+		}
+
+		template <bool forward>
+		void *scanShortAnchorsAVX2(const uint8_t *bytes, const uint8_t *mask, const PatternAnchors &anchors, uintptr_t &pCur, uintptr_t limit) {
+			if (anchors.count == 1)
+				return anchors.partial ? scanShortAVX2<1, true, forward>(bytes, mask, anchors, pCur, limit)
+									   : scanShortAVX2<1, false, forward>(bytes, mask, anchors, pCur, limit);
+			return anchors.partial ? scanShortAVX2<2, true, forward>(bytes, mask, anchors, pCur, limit)
+								   : scanShortAVX2<2, false, forward>(bytes, mask, anchors, pCur, limit);
+		}
+
+		template <bool partialAnchors, bool forward>
+		void *scanAnchorsAVX2(const uint8_t *bytes, const uint8_t *mask, const CandidateVerifier &verify, const PatternAnchors &anchors, uintptr_t &pCur,
+							  uintptr_t limit, uint64_t &numCandidates) {
+			switch (anchors.count) {
+			case 1:
+				return scanBlocksAVX2<1, partialAnchors, forward>(bytes, mask, verify, anchors, pCur, limit, numCandidates);
+			case 2:
+				return scanBlocksAVX2<2, partialAnchors, forward>(bytes, mask, verify, anchors, pCur, limit, numCandidates);
+			default:
+				return scanBlocksAVX2<3, partialAnchors, forward>(bytes, mask, verify, anchors, pCur, limit, numCandidates);
+			}
+		}
+	}  // namespace
+
 	template <bool forward>
-	void *MemScanner::findSignatureFastAVX2(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart, uintptr_t rangeEnd) {
-		if constexpr (!forward) return this->findSignatureFast1<forward>(bytes, mask, rangeStart, rangeEnd);
+	void *MemScanner::findSignatureFastAVX2(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors, uintptr_t rangeStart,
+											uintptr_t rangeEnd) {
 		const auto patternSize = (unsigned int) mask.size();
-		if (patternSize <= 2) return this->findSignatureFast1<forward>(bytes, mask, rangeStart, rangeEnd);
-		if (!MemScanner::hasFullAVXSupport()) return this->findSignatureFast8<true>(bytes, mask, rangeStart, rangeEnd);
+		// pcmpestrm (findSignatureFastSSE42) only wins on very low entropy data, the two byte anchor is faster everywhere else
+		if (!MemScanner::hasFullAVXSupport()) return this->findSignatureFastSSE<forward>(bytes, mask, anchors, rangeStart, rangeEnd);
 		if (rangeStart + 32 + bytes.size() >= rangeEnd) MEM_UNLIKELY
-		return this->findSignatureFast1<forward>(bytes, mask, rangeStart, rangeEnd);
+		return this->findSignatureFast1<forward>(bytes, mask, anchors, rangeStart, rangeEnd);
 
-		// Second byte is masked, fall back to slower method
-		if (mask[1] != 0xFF) MEM_UNLIKELY
-		return this->findSignatureFastAVX2_SecondByteMasked<forward>(bytes, mask, rangeStart, rangeEnd);
+		if (anchors.count == 0) MEM_UNLIKELY
+		return this->findSignatureFast1<forward>(bytes, mask, anchors, rangeStart, rangeEnd);
 
-		const __m256i firstByteLaidOut = _mm256_set1_epi8(*reinterpret_cast<const char *>(&bytes[0]));	 // AVX
-		const __m256i secondByteLaidOut = _mm256_set1_epi8(*reinterpret_cast<const char *>(&bytes[1]));	 // AVX
-		// const __m256i thirdByteLaidOut = _mm256_set1_epi8(*reinterpret_cast<const char *>(&bytes[2])); // AVX
+		// Every block covers 32 possible starts, the anchor loads reach at most patternSize - 1 bytes further
+		const auto lastStart = rangeEnd - patternSize;
+		uintptr_t pCur = forward ? rangeStart : lastStart - 31;
+		const uintptr_t limit = forward ? lastStart - 31 : rangeStart;
+		assert(lastStart - 31 >= rangeStart);
 
-		const auto *maskStart = mask.data();
-		const auto *bytesStart = bytes.data();
-		const auto end = std::max(rangeStart, rangeEnd - 32u - patternSize);
-		assert(end >= rangeStart);
+		uint64_t numCandidates = 0;
+		void *result = nullptr;
+		if (patternSize <= 2) {
+			result = scanShortAnchorsAVX2<forward>(bytes.data(), mask.data(), anchors, pCur, limit);
+			numCandidates = result != nullptr;
+		} else {
+			const CandidateVerifier verify(bytes.data(), mask.data(), patternSize, anchors);
+			result = anchors.partial ? scanAnchorsAVX2<true, forward>(bytes.data(), mask.data(), verify, anchors, pCur, limit, numCandidates)
+								   : scanAnchorsAVX2<false, forward>(bytes.data(), mask.data(), verify, anchors, pCur, limit, numCandidates);
+		}
+		if (result != nullptr) {
+			const auto match = reinterpret_cast<uintptr_t>(result);
+			this->countScan(ScanStats::AVX2, forward ? match - rangeStart + 1 : lastStart - match + 1, numCandidates, 1);
+			return result;
+		}
+		this->countScan(ScanStats::AVX2, forward ? pCur - rangeStart : lastStart - pCur + 1, numCandidates, 0);
 
-		for (uintptr_t pCur = rangeStart; pCur <= end; pCur += 32) {
-			const __m256i toBeCompared = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pCur));  // AVX
-			const __m256i cmp = _mm256_cmpeq_epi8(toBeCompared, firstByteLaidOut);					   // AVX2
-			auto matches = (unsigned int) (_mm256_movemask_epi8(cmp));								   // AVX2
+		// Scan the remaining bytes with the old algorithm
+		if constexpr (forward)
+			return this->findSignatureFast1<true>(bytes, mask, anchors, pCur, rangeEnd);
+		else
+			return this->findSignatureFast1<false>(bytes, mask, anchors, rangeStart, pCur + patternSize - 1);
+	}
 
-			const __m256i cmp2 = _mm256_cmpeq_epi8(toBeCompared, secondByteLaidOut);  // AVX2
-			auto matches2 = (unsigned int) _mm256_movemask_epi8(cmp2);				  // AVX2
+	void *MemScanner::findNextSignatureFastAVX2(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t rangeEnd, ScanCursor &cursor) {
+		using Phase = ScanCursor::Phase;
+		const auto patternSize = (unsigned int) mask.size();
 
-			matches &= (matches2 >> 1) | (0b1u << 31);
-			if (!matches) continue;
+		if (cursor.phase == Phase::Start) {
+			if (cursor.anchors.count == 0) cursor.anchors = MemScanner::SelectAnchors(bytes, mask);
+			cursor.phase = Phase::Scalar;
+			if (cursor.anchors.count > 0) {
+				if (MemScanner::hasFullAVXSupport()) {
+					if (cursor.position + 32 + patternSize < rangeEnd) cursor.phase = Phase::Vector;
+				} else if (cursor.position + 16 + patternSize < rangeEnd) {
+					cursor.phase = Phase::VectorSSE;
+				}
+			}
+		}
 
-			/*const __m256i cmp3 = _mm256_cmpeq_epi8(toBeCompared, thirdByteLaidOut); // AVX2
-			unsigned int matches3 = _mm256_movemask_epi8(cmp3); // AVX2
+		if (cursor.phase == Phase::VectorSSE) {
+			if (auto *result = this->findNextSignatureFastSSE(bytes, mask, rangeEnd, cursor)) return result;
+		}
 
-			matches &= (matches3 >> 2) | (0b11 << 30);
+		// Every anchor match of a pattern up to two bytes is a match, so the search simply continues behind the last one
+		if (cursor.phase == Phase::Vector && patternSize <= 2) {
+			uintptr_t pCur = cursor.position;
+			auto *result = scanShortAnchorsAVX2<true>(bytes.data(), mask.data(), cursor.anchors, pCur, rangeEnd - patternSize - 31);
+			if (result != nullptr) {
+				this->countScan(ScanStats::AVX2, reinterpret_cast<uintptr_t>(result) - cursor.position + 1, 1, 1);
+				cursor.position = reinterpret_cast<uintptr_t>(result) + 1;
+				return result;
+			}
+			this->countScan(ScanStats::AVX2, pCur - cursor.position, 0, 0);
+			cursor.position = pCur;
+			cursor.phase = Phase::Scalar;
+		}
 
-			if (!matches) continue;*/
+		if (cursor.phase == Phase::Vector) {
+			const auto *maskStart = mask.data();
+			const auto *bytesStart = bytes.data();
+			const auto &anchors = cursor.anchors;
+			const auto limit = rangeEnd - patternSize - 31;
+			const auto scanFrom = cursor.position;
+			const CandidateVerifier verify(bytesStart, maskStart, patternSize, anchors);
+			uint64_t numCandidates = 0;
 
-			unsigned long curBit = 0;
-			while (bitscanforward(&curBit, matches)) {
-				uintptr_t curP = pCur + curBit + 1;
-				unsigned int off = 1;
+			__m256i anchorBytes[3], anchorMasks[3];
+			for (unsigned int a = 0; a < anchors.count; a++) {
+				const auto offset = anchors.offsets[a];
+				anchorBytes[a] = _mm256_set1_epi8((char) (bytesStart[offset] & maskStart[offset]));  // AVX
+				anchorMasks[a] = _mm256_set1_epi8((char) maskStart[offset]);							  // AVX
+			}
 
-				for (; off < patternSize; off++) {
-					if (*(uint8_t *) curP != bytesStart[off] && maskStart[off] != 0) MEM_LIKELY
-					break;
-					curP++;
+			while (true) {
+				unsigned long curBit = 0;
+				while (bitscanforward(&curBit, cursor.pendingMatches)) {
+					cursor.pendingMatches = _blsr_u32(cursor.pendingMatches);
+					numCandidates++;
+					if (verify(reinterpret_cast<const uint8_t *>(cursor.blockStart + curBit))) MEM_UNLIKELY {
+							this->countScan(ScanStats::AVX2, cursor.position - scanFrom, numCandidates, 1);
+							return reinterpret_cast<void *>(cursor.blockStart + curBit);
+						}
 				}
-				if (off >= patternSize) MEM_UNLIKELY return reinterpret_cast<void *>(pCur + curBit);
 
-				matches = _blsr_u32(matches);
+				if (cursor.position > limit) break;
+
+				auto matches = 0xFFFFFFFFu;
+				for (unsigned int a = 0; a < anchors.count; a++) {
+					const __m256i toBeCompared = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cursor.position + anchors.offsets[a]));			// AVX
+					matches &= (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(toBeCompared, anchorMasks[a]), anchorBytes[a]));	// AVX2
+				}
+				cursor.blockStart = cursor.position;
+				cursor.pendingMatches = matches;
+				cursor.position += 32;
 			}
+			this->countScan(ScanStats::AVX2, cursor.position - scanFrom, numCandidates, 0);
+			cursor.phase = Phase::Scalar;
 		}
 
-		// Scan the remaining bytes with the old algorithm
-		return this->findSignatureFast1<true>(bytes, mask, end, rangeEnd);
+		if (cursor.phase == Phase::Scalar) {
+			// Only the tail behind the last block is left, unless the range was too short or the pattern has no anchor to begin with
+			auto *result = this->findSignatureFast1<true>(bytes, mask, cursor.anchors, cursor.position, rangeEnd);
+			if (result != nullptr) {
+				cursor.position = reinterpret_cast<uintptr_t>(result) + 1;
+				return result;
+			}
+			cursor.phase = Phase::Done;
+		}
+		return nullptr;
 	}
 
-	template <bool forward>
-	void *MemScanner::findSignatureFastAVX2_SecondByteMasked(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart,
-															 uintptr_t rangeEnd) {
-		const auto patternSize = (unsigned int) bytes.size();
-		// we don't need any checks, they were already done in the real avx2 impl
+	unsigned int MemScanner::findSignaturesFastAVX2(const MultiPatternTable &table, uintptr_t rangeStart, uintptr_t rangeEnd, std::vector<void *> &results,
+													unsigned int remaining) {
+		if (!table.useNibblePrefilter || !MemScanner::hasFullAVXSupport() || rangeStart + 33 > rangeEnd) MEM_UNLIKELY
+		return this->findSignaturesFast1(table, rangeStart, rangeEnd, results, remaining);
 
-		const __m256i firstByteLaidOut = _mm256_set1_epi8(*reinterpret_cast<const char *>(&bytes[0]));	// AVX
+		const __m256i lo0 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(table.lo0.data())));	// AVX2
+		const __m256i hi0 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(table.hi0.data())));	// AVX2
+		const __m256i lo1 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(table.lo1.data())));	// AVX2
+		const __m256i hi1 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(table.hi1.data())));	// AVX2
+		const __m256i nibbleMask = _mm256_set1_epi8(0x0F);																		// AVX
 
-		const auto *maskStart = mask.data();
-		const auto *bytesStart = bytes.data();
-		const auto end = std::max(rangeStart, rangeEnd - 32u - patternSize);
+		// the second byte of every position is read with an unaligned load one byte further
+		const auto end = rangeEnd - 33u;
+		const auto initiallyRemaining = remaining;
+		uint64_t numCandidates = 0;
+		uintptr_t pCur = rangeStart;
+		for (; pCur <= end && remaining > 0; pCur += 32) {
+			const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pCur));		 // AVX
+			const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pCur + 1));	 // AVX
 
-		for (uintptr_t pCur = rangeStart; pCur <= end; pCur += 32) {
-			const __m256i toBeCompared = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pCur));  // AVX
-			const __m256i cmp = _mm256_cmpeq_epi8(toBeCompared, firstByteLaidOut);					   // AVX2
-			auto matches = (unsigned int) _mm256_movemask_epi8(cmp);								   // AVX2
-			if (!matches) continue;
+			const __m256i firstBuckets = _mm256_and_si256(_mm256_shuffle_epi8(lo0, _mm256_and_si256(first, nibbleMask)),						   // AVX2
+														  _mm256_shuffle_epi8(hi0, _mm256_and_si256(_mm256_srli_epi16(first, 4), nibbleMask)));	   // AVX2
+			const __m256i secondBuckets = _mm256_and_si256(_mm256_shuffle_epi8(lo1, _mm256_and_si256(second, nibbleMask)),						   // AVX2
+														   _mm256_shuffle_epi8(hi1, _mm256_and_si256(_mm256_srli_epi16(second, 4), nibbleMask)));  // AVX2
+			const __m256i buckets = _mm256_and_si256(firstBuckets, secondBuckets);																   // AVX2
+			auto matches = ~(unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(buckets, _mm256_setzero_si256()));							   // AVX2
 
 			unsigned long curBit = 0;
 			while (bitscanforward(&curBit, matches)) {
-				uintptr_t curP = pCur + curBit + 1;
-				unsigned int off = 1;
-
-				for (; off < patternSize; off++) {
-					if (*(uint8_t *) curP != bytesStart[off] && maskStart[off] != 0) MEM_LIKELY
-					break;
-					curP++;
-				}
-				if (off >= patternSize) MEM_UNLIKELY return reinterpret_cast<void *>(pCur + curBit);
-
+				numCandidates++;
+				remaining -= table.verify(pCur + curBit, rangeStart, rangeEnd, results);
 				matches = _blsr_u32(matches);
 			}
 		}
+		this->countScan(ScanStats::MultiAVX2, pCur - rangeStart, numCandidates, initiallyRemaining - remaining);
 
-		return this->findSignatureFast1<true>(bytes, mask, end, rangeEnd);
+		return this->findSignaturesFast1(table, rangeStart, rangeEnd, results, remaining, pCur);
 	}
 
-	template void *MemScanner::findSignatureFastAVX2<true>(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart,
-														   uintptr_t rangeEnd);
+	template void *MemScanner::findSignatureFastAVX2<true>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors,
+														   uintptr_t rangeStart, uintptr_t rangeEnd);
 
-	template void *MemScanner::findSignatureFastAVX2<false>(const std::vector<uint8_t> &bytes, const std::vector<uint8_t> &mask, uintptr_t rangeStart,
-															uintptr_t rangeEnd);
-}  // namespace MemScanner
\ No newline at end of file
+	template void *MemScanner::findSignatureFastAVX2<false>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors,
+															uintptr_t rangeStart, uintptr_t rangeEnd);
+}  // namespace MemScanner
@@ -0,0 +1,235 @@
+#include <MemScanner/Macros.h>
+#include <MemScanner/MemScanner.h>
+
+#include <cassert>
+
+namespace MemScanner {
+	namespace {
+		// Same as scanBlocksAVX2, with 16 candidate positions per iteration
+		template <unsigned int numAnchors, bool partialAnchors, bool forward>
+		void *scanBlocksSSE(const uint8_t *bytes, const uint8_t *mask, unsigned int patternSize, const PatternAnchors &anchors, uintptr_t &pCur,
+							uintptr_t limit, uint64_t &numCandidates) {
+			uint64_t candidates = 0;
+			__m128i anchorBytes[numAnchors], anchorMasks[numAnchors];
+			for (unsigned int a = 0; a < numAnchors; a++) {
+				const auto offset = anchors.offsets[a];
+				anchorBytes[a] = _mm_set1_epi8((char) (bytes[offset] & mask[offset]));	// SSE2
+				anchorMasks[a] = _mm_set1_epi8((char) mask[offset]);					// SSE2
+			}
+
+			while (forward ? (pCur <= limit) : true) {
+				auto matches = 0xFFFFu;
+				for (unsigned int a = 0; a < numAnchors; a++) {
+					__m128i toBeCompared = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pCur + anchors.offsets[a]));  // SSE2
+					if constexpr (partialAnchors) toBeCompared = _mm_and_si128(toBeCompared, anchorMasks[a]);			   // SSE2
+					matches &= (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(toBeCompared, anchorBytes[a]));			   // SSE2
+				}
+
+				unsigned long curBit = 0;
+				while (forward ? bitscanforward(&curBit, matches) : bitscanreverse(&curBit, matches)) {
+					candidates++;
+					const auto *curP = reinterpret_cast<const uint8_t *>(pCur + curBit);
+					unsigned int off = 0;
+
+					for (; off < patternSize; off++) {
+						if (((curP[off] ^ bytes[off]) & mask[off]) != 0) MEM_LIKELY
+						break;
+					}
+					if (off >= patternSize) MEM_UNLIKELY {
+							numCandidates = candidates;
+							return reinterpret_cast<void *>(pCur + curBit);
+						}
+
+					matches &= ~(1u << curBit);
+				}
+
+				if constexpr (forward) {
+					pCur += 16;
+				} else {
+					if (pCur < limit + 16) break;
+					pCur -= 16;
+				}
+			}
+			numCandidates = candidates;
+			return nullptr;
+		}
+
+		// Same as scanShortAVX2, with 32 starts per iteration while two blocks fit
+		template <unsigned int numAnchors, bool partialAnchors, bool forward>
+		void *scanShortSSE(const uint8_t *bytes, const uint8_t *mask, const PatternAnchors &anchors, uintptr_t &pCur, uintptr_t limit) {
+			__m128i anchorBytes[numAnchors], anchorMasks[numAnchors];
+			for (unsigned int a = 0; a < numAnchors; a++) {
+				const auto offset = anchors.offsets[a];
+				anchorBytes[a] = _mm_set1_epi8((char) (bytes[offset] & mask[offset]));	// SSE2
+				anchorMasks[a] = _mm_set1_epi8((char) mask[offset]);					// SSE2
+			}
+			auto blockMatches = [&](uintptr_t block) {
+				__m128i equal = _mm_set1_epi8((char) 0xFF);	 // SSE2
+				for (unsigned int a = 0; a < numAnchors; a++) {
+					__m128i toBeCompared = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + anchors.offsets[a]));  // SSE2
+					if constexpr (partialAnchors) toBeCompared = _mm_and_si128(toBeCompared, anchorMasks[a]);			   // SSE2
+					equal = _mm_and_si128(equal, _mm_cmpeq_epi8(toBeCompared, anchorBytes[a]));						   // SSE2
+				}
+				return (unsigned int) _mm_movemask_epi8(equal);	 // SSE2
+			};
+
+			unsigned long curBit = 0;
+			if constexpr (forward) {
+				for (; pCur + 16 <= limit; pCur += 32) {
+					const auto matches = blockMatches(pCur) | blockMatches(pCur + 16) << 16;
+					if (matches == 0) MEM_LIKELY
+					continue;
+					bitscanforward(&curBit, matches);
+					return reinterpret_cast<void *>(pCur + curBit);
+				}
+				for (; pCur <= limit; pCur += 16) {
+					if (bitscanforward(&curBit, blockMatches(pCur))) return reinterpret_cast<void *>(pCur + curBit);
+				}
+			} else {
+				while (pCur >= limit + 16) {
+					const auto matches = blockMatches(pCur - 16) | blockMatches(pCur) << 16;
+					if (matches != 0) MEM_UNLIKELY {
+							bitscanreverse(&curBit, matches);
+							return reinterpret_cast<void *>(pCur - 16 + curBit);
+						}
+					pCur -= 16;
+					if (pCur < limit + 16) return nullptr;
+					pCur -= 16;
+				}
+				if (bitscanreverse(&curBit, blockMatches(pCur))) return reinterpret_cast<void *>(pCur + curBit);
+			}
+			return nullptr;
+		}
+
+		template <bool forward>
+		void *scanShortAnchorsSSE(const uint8_t *bytes, const uint8_t *mask, const PatternAnchors &anchors, uintptr_t &pCur, uintptr_t limit) {
+			if (anchors.count == 1)
+				return anchors.partial ? scanShortSSE<1, true, forward>(bytes, mask, anchors, pCur, limit)
+									   : scanShortSSE<1, false, forward>(bytes, mask, anchors, pCur, limit);
+			return anchors.partial ? scanShortSSE<2, true, forward>(bytes, mask, anchors, pCur, limit)
+								   : scanShortSSE<2, false, forward>(bytes, mask, anchors, pCur, limit);
+		}
+
+		template <bool partialAnchors, bool forward>
+		void *scanAnchorsSSE(const uint8_t *bytes, const uint8_t *mask, unsigned int patternSize, const PatternAnchors &anchors, uintptr_t &pCur,
+							 uintptr_t limit, uint64_t &numCandidates) {
+			switch (anchors.count) {
+			case 1:
+				return scanBlocksSSE<1, partialAnchors, forward>(bytes, mask, patternSize, anchors, pCur, limit, numCandidates);
+			case 2:
+				return scanBlocksSSE<2, partialAnchors, forward>(bytes, mask, patternSize, anchors, pCur, limit, numCandidates);
+			default:
+				return scanBlocksSSE<3, partialAnchors, forward>(bytes, mask, patternSize, anchors, pCur, limit, numCandidates);
+			}
+		}
+	}  // namespace
+
+	template <bool forward>
+	void *MemScanner::findSignatureFastSSE(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors, uintptr_t rangeStart,
+										   uintptr_t rangeEnd) {
+		const auto patternSize = (unsigned int) mask.size();
+		if (rangeStart + 16 + bytes.size() >= rangeEnd) MEM_UNLIKELY
+		return this->findSignatureFast1<forward>(bytes, mask, anchors, rangeStart, rangeEnd);
+
+		if (anchors.count == 0) MEM_UNLIKELY
+		return this->findSignatureFast1<forward>(bytes, mask, anchors, rangeStart, rangeEnd);
+
+		// Every block covers 16 possible starts, the anchor loads reach at most patternSize - 1 bytes further
+		const auto lastStart = rangeEnd - patternSize;
+		uintptr_t pCur = forward ? rangeStart : lastStart - 15;
+		const uintptr_t limit = forward ? lastStart - 15 : rangeStart;
+		assert(lastStart - 15 >= rangeStart);
+
+		uint64_t numCandidates = 0;
+		void *result = nullptr;
+		if (patternSize <= 2) {
+			result = scanShortAnchorsSSE<forward>(bytes.data(), mask.data(), anchors, pCur, limit);
+			numCandidates = result != nullptr;
+		} else {
+			result = anchors.partial ? scanAnchorsSSE<true, forward>(bytes.data(), mask.data(), patternSize, anchors, pCur, limit, numCandidates)
+									 : scanAnchorsSSE<false, forward>(bytes.data(), mask.data(), patternSize, anchors, pCur, limit, numCandidates);
+		}
+		if (result != nullptr) {
+			const auto match = reinterpret_cast<uintptr_t>(result);
+			this->countScan(ScanStats::SSE, forward ? match - rangeStart + 1 : lastStart - match + 1, numCandidates, 1);
+			return result;
+		}
+		this->countScan(ScanStats::SSE, forward ? pCur - rangeStart : lastStart - pCur + 1, numCandidates, 0);
+
+		// Scan the remaining bytes with the old algorithm
+		if constexpr (forward)
+			return this->findSignatureFast1<true>(bytes, mask, anchors, pCur, rangeEnd);
+		else
+			return this->findSignatureFast1<false>(bytes, mask, anchors, rangeStart, pCur + patternSize - 1);
+	}
+
+	void *MemScanner::findNextSignatureFastSSE(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t rangeEnd, ScanCursor &cursor) {
+		const auto patternSize = (unsigned int) mask.size();
+		const auto *maskStart = mask.data();
+		const auto *bytesStart = bytes.data();
+		const auto &anchors = cursor.anchors;
+		const auto limit = rangeEnd - patternSize - 15;
+		const auto scanFrom = cursor.position;
+		cursor.phase = ScanCursor::Phase::Scalar;  // until a match says otherwise
+
+		if (patternSize <= 2) {
+			uintptr_t pCur = cursor.position;
+			auto *result = scanShortAnchorsSSE<true>(bytesStart, maskStart, anchors, pCur, limit);
+			if (result != nullptr) {
+				this->countScan(ScanStats::SSE, reinterpret_cast<uintptr_t>(result) - scanFrom + 1, 1, 1);
+				cursor.position = reinterpret_cast<uintptr_t>(result) + 1;
+				cursor.phase = ScanCursor::Phase::VectorSSE;
+				return result;
+			}
+			this->countScan(ScanStats::SSE, pCur - scanFrom, 0, 0);
+			cursor.position = pCur;
+			return nullptr;
+		}
+
+		__m128i anchorBytes[3], anchorMasks[3];
+		for (unsigned int a = 0; a < anchors.count; a++) {
+			const auto offset = anchors.offsets[a];
+			anchorBytes[a] = _mm_set1_epi8((char) (bytesStart[offset] & maskStart[offset]));	 // SSE2
+			anchorMasks[a] = _mm_set1_epi8((char) maskStart[offset]);						 // SSE2
+		}
+
+		uint64_t numCandidates = 0;
+		while (true) {
+			unsigned long curBit = 0;
+			while (bitscanforward(&curBit, cursor.pendingMatches)) {
+				cursor.pendingMatches &= cursor.pendingMatches - 1;
+				numCandidates++;
+				const auto *curP = reinterpret_cast<const uint8_t *>(cursor.blockStart + curBit);
+				unsigned int off = 0;
+				for (; off < patternSize; off++) {
+					if (((curP[off] ^ bytesStart[off]) & maskStart[off]) != 0) MEM_LIKELY
+					break;
+				}
+				if (off >= patternSize) MEM_UNLIKELY {
+						this->countScan(ScanStats::SSE, cursor.position - scanFrom, numCandidates, 1);
+						cursor.phase = ScanCursor::Phase::VectorSSE;
+						return reinterpret_cast<void *>(cursor.blockStart + curBit);
+					}
+			}
+
+			if (cursor.position > limit) break;
+
+			auto matches = 0xFFFFu;
+			for (unsigned int a = 0; a < anchors.count; a++) {
+				const __m128i toBeCompared = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cursor.position + anchors.offsets[a]));		  // SSE2
+				matches &= (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(toBeCompared, anchorMasks[a]), anchorBytes[a]));  // SSE2
+			}
+			cursor.blockStart = cursor.position;
+			cursor.pendingMatches = matches;
+			cursor.position += 16;
+		}
+		this->countScan(ScanStats::SSE, cursor.position - scanFrom, numCandidates, 0);
+		return nullptr;
+	}
+
+	template void *MemScanner::findSignatureFastSSE<true>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors,
+														  uintptr_t rangeStart, uintptr_t rangeEnd);
+
+	template void *MemScanner::findSignatureFastSSE<false>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, const PatternAnchors &anchors,
+														   uintptr_t rangeStart, uintptr_t rangeEnd);
+}  // namespace MemScanner
@@ -0,0 +1,68 @@
+#include <MemScanner/Macros.h>
+#include <MemScanner/MemScanner.h>
+
+#include <cassert>
+
+namespace MemScanner {
+	template <bool forward>
+	void *MemScanner::findSignatureFastSSE42(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t rangeStart, uintptr_t rangeEnd) {
+		const auto patternSize = (unsigned int) mask.size();
+		if (patternSize <= 2) return this->findSignatureFastSSE<forward>(bytes, mask, rangeStart, rangeEnd);
+		if (rangeStart + 16 + bytes.size() >= rangeEnd) MEM_UNLIKELY
+		return this->findSignatureFast1<forward>(bytes, mask, rangeStart, rangeEnd);
+		if constexpr (!forward) return this->findSignatureFastSSE<forward>(bytes, mask, rangeStart, rangeEnd);
+
+		// pcmpestrm matches the leading run of unmasked bytes as a whole, the rest is verified by hand
+		int prefixLength = 0;
+		alignas(16) uint8_t prefix[16]{};
+		while (prefixLength < 16 && prefixLength < (int) patternSize && mask[prefixLength] == 0xFF) {
+			prefix[prefixLength] = bytes[prefixLength];
+			prefixLength++;
+		}
+		if (prefixLength < 3) return this->findSignatureFastSSE<forward>(bytes, mask, rangeStart, rangeEnd);
+
+		const __m128i needle = _mm_load_si128(reinterpret_cast<const __m128i *>(prefix));  // SSE2
+
+		const auto *maskStart = mask.data();
+		const auto *bytesStart = bytes.data();
+		const auto end = std::max(rangeStart, rangeEnd - 16u - patternSize);
+		assert(end >= rangeStart);
+
+		uint64_t numCandidates = 0;
+		for (uintptr_t pCur = rangeStart; pCur <= end; pCur += 16) {
+			const __m128i toBeCompared = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pCur));	// SSE2
+			// Bit i is set if the prefix matches at i, prefixes that run past the block only match partially
+			const __m128i cmp = _mm_cmpestrm(needle, prefixLength, toBeCompared, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ORDERED | _SIDD_BIT_MASK);  // SSE4.2
+			auto matches = (unsigned int) _mm_cvtsi128_si32(cmp);																				   // SSE2
+			if (!matches) continue;
+
+			unsigned long curBit = 0;
+			while (bitscanforward(&curBit, matches)) {
+				numCandidates++;
+				uintptr_t curP = pCur + curBit + 1;
+				unsigned int off = 1;
+
+				for (; off < patternSize; off++) {
+					if (((*(uint8_t *) curP ^ bytesStart[off]) & maskStart[off]) != 0) MEM_LIKELY
+					break;
+					curP++;
+				}
+				if (off >= patternSize) MEM_UNLIKELY {
+						this->countScan(ScanStats::SSE42, pCur + curBit - rangeStart + 1, numCandidates, 1);
+						return reinterpret_cast<void *>(pCur + curBit);
+					}
+
+				matches &= matches - 1;
+			}
+		}
+
+		this->countScan(ScanStats::SSE42, end - rangeStart, numCandidates, 0);
+		return this->findSignatureFast1<true>(bytes, mask, end, rangeEnd);
+	}
+
+	template void *MemScanner::findSignatureFastSSE42<true>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t rangeStart,
+															uintptr_t rangeEnd);
+
+	template void *MemScanner::findSignatureFastSSE42<false>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t rangeStart,
+															 uintptr_t rangeEnd);
+}  // namespace MemScanner
@@ -0,0 +1,139 @@
+#include <MemScanner/NGramIndex.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+
+namespace MemScanner {
+
+	namespace {
+		constexpr size_t minGramsPerChunk = 1 << 16;  // smaller ranges are not worth a histogram per thread
+		constexpr size_t bucketsPerSortJob = 256;
+
+		// Calls fn(i) for every i in [0, count), spread over the threads of pool
+		template <class Fn>
+		void parallelFor(ThreadPool *pool, size_t count, Fn &&fn) {
+			std::atomic<size_t> next = 0;
+			const std::function<void()> job = [&]() {
+				for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) fn(i);
+			};
+			if (pool != nullptr && count > 1)
+				pool->run(job, (unsigned int) std::min<size_t>(count, pool->numWorkers() + 1));
+			else
+				job();
+		}
+	}  // namespace
+
+	NGramIndex::NGramIndex(uintptr_t start, uintptr_t end, ThreadPool *pool) : indexStart(start), indexEnd(std::max(start, end)) {
+		const auto size = indexEnd - indexStart;
+		if (size > UINT32_MAX) throw std::runtime_error("range too large for an n-gram index");
+
+		bucketStarts.assign(numBuckets + 1, 0);
+		if (size < gramSize) return;
+
+		const auto *base = reinterpret_cast<const uint8_t *>(indexStart);
+		const auto numGrams = size - gramSize + 1;
+		const size_t numThreads = pool != nullptr ? pool->numWorkers() + 1 : 1;
+		const auto numChunks = std::clamp<size_t>((numGrams + minGramsPerChunk - 1) / minGramsPerChunk, 1, numThreads);
+		const auto chunkSize = (numGrams + numChunks - 1) / numChunks;
+		auto bucketOf = [base](size_t pos) { return (size_t) base[pos] << 8 | base[pos + 1]; };
+		auto suffixOf = [base](uint32_t pos) { return (uint32_t) base[pos + 2] << 8 | base[pos + 3]; };
+
+		// Counting sort by the first two bytes: a histogram per chunk, then every chunk scatters its positions
+		std::vector<uint32_t> offsets(numChunks * numBuckets, 0);
+		parallelFor(pool, numChunks, [&](size_t chunk) {
+			auto *counts = &offsets[chunk * numBuckets];
+			for (size_t pos = chunk * chunkSize, last = std::min(pos + chunkSize, numGrams); pos < last; pos++) counts[bucketOf(pos)]++;
+		});
+
+		// Chunks are laid out in order within every bucket, so the positions of a bucket end up ascending
+		uint32_t total = 0;
+		for (size_t bucket = 0; bucket < numBuckets; bucket++) {
+			bucketStarts[bucket] = total;
+			for (size_t chunk = 0; chunk < numChunks; chunk++) {
+				const auto count = offsets[chunk * numBuckets + bucket];
+				offsets[chunk * numBuckets + bucket] = total;
+				total += count;
+			}
+		}
+		bucketStarts[numBuckets] = total;
+
+		positions.resize(numGrams);
+		parallelFor(pool, numChunks, [&](size_t chunk) {
+			auto *chunkOffsets = &offsets[chunk * numBuckets];
+			for (size_t pos = chunk * chunkSize, last = std::min(pos + chunkSize, numGrams); pos < last; pos++)
+				positions[chunkOffsets[bucketOf(pos)]++] = (uint32_t) pos;
+		});
+
+		// Sort every bucket by the last two bytes, on packed keys so the comparisons do not read the range
+		parallelFor(pool, numBuckets / bucketsPerSortJob, [&](size_t job) {
+			std::vector<uint64_t> keys;
+			for (size_t bucket = job * bucketsPerSortJob; bucket < (job + 1) * bucketsPerSortJob; bucket++) {
+				const auto first = positions.begin() + bucketStarts[bucket], last = positions.begin() + bucketStarts[bucket + 1];
+				keys.clear();
+				for (auto it = first; it != last; it++) keys.push_back((uint64_t) suffixOf(*it) << 32 | *it);
+				std::sort(keys.begin(), keys.end());
+				std::transform(keys.begin(), keys.end(), first, [](uint64_t key) { return (uint32_t) key; });
+			}
+		});
+	}
+
+	std::pair<const uint32_t *, const uint32_t *> NGramIndex::candidates(const uint8_t *gram) const {
+		const auto *base = reinterpret_cast<const uint8_t *>(indexStart);
+		const auto bucket = (size_t) gram[0] << 8 | gram[1];
+		const auto suffix = (uint32_t) gram[2] << 8 | gram[3];
+		auto suffixOf = [base](uint32_t pos) { return (uint32_t) base[pos + 2] << 8 | base[pos + 3]; };
+
+		const auto *first = positions.data() + bucketStarts[bucket], *last = positions.data() + bucketStarts[bucket + 1];
+		first = std::partition_point(first, last, [&](uint32_t pos) { return suffixOf(pos) < suffix; });
+		last = std::partition_point(first, last, [&](uint32_t pos) { return suffixOf(pos) == suffix; });
+		return {first, last};
+	}
+
+	template <bool forward>
+	bool NGramIndex::find(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, void *&result) const {
+		if (bytes.size() != mask.size() || !covers(start, end) || positions.empty()) return false;
+
+		// Use the 4-gram with the fewest positions
+		bool hasGram = false;
+		size_t gramOffset = 0;
+		const uint32_t *first = nullptr, *last = nullptr;
+		for (size_t off = 0; off + gramSize <= bytes.size(); off++) {
+			if (!std::all_of(mask.begin() + off, mask.begin() + off + gramSize, [](uint8_t m) { return m == 0xFF; })) continue;
+			const auto [gramFirst, gramLast] = this->candidates(bytes.data() + off);
+			if (hasGram && gramLast - gramFirst >= last - first) continue;
+			hasGram = true;
+			gramOffset = off;
+			first = gramFirst;
+			last = gramLast;
+		}
+		if (!hasGram) return false;
+
+		result = nullptr;
+		if (end < start + bytes.size()) return true;
+
+		// the 4-gram of a match that starts at s is at s + gramOffset
+		const auto lowest = (uint32_t) (start - indexStart + gramOffset), highest = (uint32_t) (end - bytes.size() - indexStart + gramOffset);
+		first = std::lower_bound(first, last, lowest);
+		last = std::upper_bound(first, last, highest);
+
+		auto matchAt = [&](uint32_t pos) -> void * {
+			const auto *match = reinterpret_cast<const uint8_t *>(indexStart + pos - gramOffset);
+			for (size_t i = 0; i < bytes.size(); i++)
+				if (((match[i] ^ bytes[i]) & mask[i]) != 0) return nullptr;
+			return const_cast<uint8_t *>(match);
+		};
+		if constexpr (forward) {
+			for (auto *it = first; it != last && result == nullptr; it++) result = matchAt(*it);
+		} else {
+			for (auto *it = last; it != first && result == nullptr;) result = matchAt(*--it);
+		}
+		return true;
+	}
+
+	template bool NGramIndex::find<true>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, void *&result) const;
+
+	template bool NGramIndex::find<false>(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end, void *&result) const;
+
+}  // namespace MemScanner
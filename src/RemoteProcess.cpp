@@ -0,0 +1,214 @@
+#include <MemScanner/RemoteProcess.h>
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace MemScanner {
+
+	RemoteProcess::RemoteProcess(int pid, size_t chunkSize) : pid(pid), chunkSize(std::max<size_t>(chunkSize, 1)) {}
+
+	RemoteProcess::~RemoteProcess() {
+#ifdef __linux__
+		if (memFd >= 0) close(memFd);
+#endif
+	}
+
+	void RemoteProcess::read(uintptr_t address, void *buffer, size_t size) {
+#ifdef __linux__
+		auto *out = static_cast<uint8_t *>(buffer);
+		size_t done = 0;
+		while (done < size && useVmReadv) {
+			iovec local{out + done, size - done}, remote{reinterpret_cast<void *>(address + done), size - done};
+			const auto numRead = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+			if (numRead > 0) {
+				done += (size_t) numRead;
+				continue;
+			}
+			// Not available to this process (kernel config or seccomp), /proc/<pid>/mem might still be
+			if (numRead < 0 && (errno == ENOSYS || errno == EPERM)) {
+				useVmReadv = false;
+				break;
+			}
+			throw std::runtime_error("could not read remote memory");
+		}
+
+		while (done < size) {
+			if (memFd < 0) {
+				memFd = open(("/proc/" + std::to_string(pid) + "/mem").c_str(), O_RDONLY | O_CLOEXEC);
+				if (memFd < 0) throw std::runtime_error("could not open remote memory");
+			}
+			const auto numRead = pread(memFd, out + done, size - done, (off_t) (address + done));
+			if (numRead <= 0) throw std::runtime_error("could not read remote memory");
+			done += (size_t) numRead;
+		}
+#else
+		throw std::runtime_error("not implemented");
+#endif
+	}
+
+	void RemoteProcess::forEachChunk(uintptr_t start, uintptr_t end, size_t overlap, bool forward,
+									 const std::function<bool(uintptr_t, const uint8_t *, size_t)> &fn) {
+		if (end <= start || end - start <= overlap) return;
+
+		// Chunk k is responsible for the matches that start in [start + k * chunkSize, start + (k + 1) * chunkSize)
+		const auto numChunks = (end - start - overlap + chunkSize - 1) / chunkSize;
+		auto chunkAt = [&](size_t i) {
+			const auto address = start + (forward ? i : numChunks - 1 - i) * chunkSize;
+			return std::make_pair(address, std::min(chunkSize + overlap, end - address));
+		};
+
+		std::array<std::vector<uint8_t>, 2> buffers;
+		buffers[0].resize(std::min(chunkSize + overlap, end - start));
+		if (numChunks == 1) {
+			const auto [address, size] = chunkAt(0);
+			this->read(address, buffers[0].data(), size);
+			fn(address, buffers[0].data(), size);
+			return;
+		}
+		buffers[1].resize(buffers[0].size());
+
+		// The reader fills buffers[i % 2] with chunk i while the calling thread scans chunk i - 1 in the other one
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::array<bool, 2> filled{};
+		bool stop = false;
+		size_t failedChunk = SIZE_MAX;
+		std::exception_ptr readError;
+
+		std::thread reader([&]() {
+			for (size_t i = 0; i < numChunks; i++) {
+				{
+					std::unique_lock l(mutex);
+					changed.wait(l, [&] { return stop || !filled[i % 2]; });
+					if (stop) return;
+				}
+				const auto [address, size] = chunkAt(i);
+				std::exception_ptr error;
+				try {
+					this->read(address, buffers[i % 2].data(), size);
+				} catch (...) {
+					error = std::current_exception();
+				}
+				{
+					std::lock_guard l(mutex);
+					filled[i % 2] = true;
+					if (error) {
+						failedChunk = i;
+						readError = error;
+					}
+				}
+				changed.notify_all();
+				if (error) return;
+			}
+		});
+
+		// A read error only counts once the scan gets to the chunk, the prefetch of the chunk after the last one scanned may fail
+		std::exception_ptr scanError, reachedReadError;
+		for (size_t i = 0; i < numChunks; i++) {
+			{
+				std::unique_lock l(mutex);
+				changed.wait(l, [&] { return filled[i % 2]; });
+				if (failedChunk == i) {
+					reachedReadError = readError;
+					break;
+				}
+			}
+			const auto [address, size] = chunkAt(i);
+			bool done = true;
+			try {
+				done = fn(address, buffers[i % 2].data(), size);
+			} catch (...) {
+				scanError = std::current_exception();
+			}
+			{
+				std::lock_guard l(mutex);
+				filled[i % 2] = false;
+				stop = done;
+			}
+			changed.notify_all();
+			if (done) break;
+		}
+		{
+			std::lock_guard l(mutex);
+			stop = true;
+		}
+		changed.notify_all();
+		reader.join();
+
+		if (scanError) std::rethrow_exception(scanError);
+		if (reachedReadError) std::rethrow_exception(reachedReadError);
+	}
+
+	namespace {
+		void ValidatePattern(std::span<const uint8_t> bytes, std::span<const uint8_t> mask) {
+			if (bytes.empty() || bytes.size() != mask.size()) throw std::runtime_error("invalid signature size");
+			if (std::all_of(mask.begin(), mask.end(), [](uint8_t m) { return m == 0; })) throw std::runtime_error("invalid pattern");
+		}
+	}  // namespace
+
+	template <bool forward>
+	uintptr_t RemoteProcess::findSignatureInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end) {
+		ValidatePattern(bytes, mask);
+		const auto anchors = MemScanner::SelectAnchors(bytes, mask);
+		uintptr_t result = 0;
+		this->forEachChunk(start, end, bytes.size() - 1, forward, [&](uintptr_t address, const uint8_t *data, size_t size) {
+			const auto localStart = reinterpret_cast<uintptr_t>(data);
+			auto *match = scanner.findSignatureFastAVX2<forward>(bytes, mask, anchors, localStart, localStart + size);
+			if (match == nullptr) return false;
+			result = address + (reinterpret_cast<uintptr_t>(match) - localStart);
+			return true;
+		});
+		return result;
+	}
+
+	template uintptr_t RemoteProcess::findSignatureInRange<true>(std::span<const uint8_t>, std::span<const uint8_t>, uintptr_t, uintptr_t);
+
+	template uintptr_t RemoteProcess::findSignatureInRange<false>(std::span<const uint8_t>, std::span<const uint8_t>, uintptr_t, uintptr_t);
+
+	template <bool forward>
+	uintptr_t RemoteProcess::findSignatureInRange(const char *szSignature, uintptr_t start, uintptr_t end) {
+		auto [patternBytes, patternMask] = MemScanner::ParseSignature(szSignature);
+		return this->findSignatureInRange<forward>(patternBytes, patternMask, start, end);
+	}
+
+	template uintptr_t RemoteProcess::findSignatureInRange<true>(const char *, uintptr_t, uintptr_t);
+
+	template uintptr_t RemoteProcess::findSignatureInRange<false>(const char *, uintptr_t, uintptr_t);
+
+	size_t RemoteProcess::findAllSignaturesInRange(std::span<const uint8_t> bytes, std::span<const uint8_t> mask, uintptr_t start, uintptr_t end,
+												   std::vector<uintptr_t> &results, size_t maxMatches) {
+		ValidatePattern(bytes, mask);
+		if (maxMatches == 0) return 0;
+		const auto anchors = MemScanner::SelectAnchors(bytes, mask);
+		size_t numFound = 0;
+		this->forEachChunk(start, end, bytes.size() - 1, true, [&](uintptr_t address, const uint8_t *data, size_t size) {
+			const auto localStart = reinterpret_cast<uintptr_t>(data);
+			// one resumable scan per chunk, restarting after every match would rescan dense chunks over and over
+			MemScanner::ScanCursor cursor(localStart);
+			cursor.anchors = anchors;
+			while (true) {
+				auto *match = scanner.findNextSignatureFastAVX2(bytes, mask, localStart + size, cursor);
+				const auto offset = reinterpret_cast<uintptr_t>(match) - localStart;
+				if (match == nullptr || offset >= chunkSize) break;	 // the rest belongs to the next chunk
+				results.push_back(address + offset);
+				if (++numFound == maxMatches) return true;
+			}
+			return false;
+		});
+		return numFound;
+	}
+
+}  // namespace MemScanner
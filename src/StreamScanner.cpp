@@ -0,0 +1,59 @@
+#include <MemScanner/StreamScanner.h>
+
+#include <algorithm>
+
+namespace MemScanner {
+
+	StreamScanner::StreamScanner(MemScanner::Pattern pattern) : pattern(std::move(pattern)) {
+		carry.reserve(this->pattern.size());
+		junction.reserve(2 * this->pattern.size());
+	}
+
+	size_t StreamScanner::scan(uintptr_t start, uintptr_t end, uint64_t base, std::vector<uint64_t> &offsets, size_t maxMatches) {
+		const auto rangeStart = start;
+		size_t numFound = 0;
+		while (numFound < maxMatches && start + pattern.size() <= end) {
+			const auto capacity = std::min(matchBuffer.size(), maxMatches - numFound);
+			const auto count = scanner.findAllSignaturesInRange(pattern, start, end, matchBuffer.data(), capacity, false);
+			for (size_t i = 0; i < count; i++) offsets.push_back(base + (reinterpret_cast<uintptr_t>(matchBuffer[i]) - rangeStart));
+			numFound += count;
+			if (count < capacity) break;
+			start = reinterpret_cast<uintptr_t>(matchBuffer[count - 1]) + 1;
+		}
+		return numFound;
+	}
+
+	size_t StreamScanner::feed(std::span<const uint8_t> chunk, std::vector<uint64_t> &offsets, size_t maxMatches) {
+		const auto overlap = pattern.size() - 1;
+		size_t numFound = 0;
+
+		// Matches that start in the carried bytes end within the first overlap bytes of the chunk
+		if (!carry.empty() && !chunk.empty()) {
+			junction.assign(carry.begin(), carry.end());
+			junction.insert(junction.end(), chunk.begin(), chunk.begin() + (ptrdiff_t) std::min(overlap, chunk.size()));
+			const auto start = reinterpret_cast<uintptr_t>(junction.data());
+			numFound += this->scan(start, start + junction.size(), numFed - carry.size(), offsets, maxMatches);
+		}
+
+		// Everything else is scanned in place
+		if (numFound < maxMatches && !chunk.empty()) {
+			const auto start = reinterpret_cast<uintptr_t>(chunk.data());
+			numFound += this->scan(start, start + chunk.size(), numFed, offsets, maxMatches - numFound);
+		}
+
+		if (chunk.size() >= overlap) {
+			carry.assign(chunk.end() - (ptrdiff_t) overlap, chunk.end());
+		} else {
+			carry.insert(carry.end(), chunk.begin(), chunk.end());
+			if (carry.size() > overlap) carry.erase(carry.begin(), carry.begin() + (ptrdiff_t) (carry.size() - overlap));
+		}
+		numFed += chunk.size();
+		return numFound;
+	}
+
+	void StreamScanner::reset() {
+		carry.clear();
+		numFed = 0;
+	}
+
+}  // namespace MemScanner
@@ -0,0 +1,62 @@
+#include <MemScanner/ThreadPool.h>
+
+#include <algorithm>
+
+namespace MemScanner {
+
+	ThreadPool::ThreadPool(unsigned int numWorkers) {
+		workers.reserve(numWorkers);
+		for (unsigned int i = 0; i < numWorkers; i++) workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+
+	ThreadPool::~ThreadPool() {
+		std::unique_lock l(mutex);
+		shouldShutdown = true;
+		l.unlock();
+		jobReady.notify_all();
+		for (auto &worker : workers)
+			if (worker.joinable()) worker.join();
+	}
+
+	void ThreadPool::workerLoop(unsigned int index) {
+		uint64_t seenGeneration = 0;
+		std::unique_lock l(mutex);
+		while (true) {
+			jobReady.wait(l, [&] { return shouldShutdown || generation != seenGeneration; });
+			if (shouldShutdown) return;
+
+			seenGeneration = generation;
+			if (index >= numRequested) continue;
+
+			const auto *curJob = job;
+			l.unlock();
+			(*curJob)();
+			l.lock();
+			if (--numRunning == 0) jobDone.notify_all();
+		}
+	}
+
+	void ThreadPool::run(const std::function<void()> &fn, unsigned int numThreads) {
+		std::lock_guard r(runMutex);
+		std::unique_lock l(mutex);
+		numRequested = std::min(numThreads > 0 ? numThreads - 1 : 0, (unsigned int) workers.size());
+		if (numRequested == 0) {
+			l.unlock();
+			fn();
+			return;
+		}
+
+		job = &fn;
+		numRunning = numRequested;
+		generation++;
+		l.unlock();
+		jobReady.notify_all();
+
+		fn();
+
+		l.lock();
+		jobDone.wait(l, [&] { return numRunning == 0; });
+		job = nullptr;
+	}
+
+}  // namespace MemScanner
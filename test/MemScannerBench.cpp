@@ -0,0 +1,362 @@
+#include <MemScanner/Mem.h>
+#include <MemScanner/MemScanner.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Standalone throughput benchmark of the individual scan kernels.
+//   MemScannerBench [--quick] [--filter <text>] [--json <file>] [--compare <baseline.json>] [--threshold <percent>]
+// Every kernel scans every data set for every pattern shape. The patterns are adjusted so they don't occur in the data, so every
+// measurement covers the whole range. --json writes the results, --compare reports the change against a file written before and
+// exits with 1 if anything got slower by more than the threshold (default 10%)
+
+namespace {
+	using Scanner = MemScanner::MemScanner;
+
+	struct Kernel {
+		const char* name;
+		bool (*supported)();
+		bool (*accepts)(const std::vector<uint8_t>& mask, bool forward);
+		void* (*scan)(Scanner& scanner, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, const MemScanner::PatternAnchors& anchors,
+					  uintptr_t start, uintptr_t end, bool forward);
+	};
+
+	bool Always() { return true; }
+
+	bool AnyPattern(const std::vector<uint8_t>&, bool) { return true; }
+
+	bool ForwardOnly(const std::vector<uint8_t>&, bool forward) { return forward; }
+
+	// The standard library baselines only handle short patterns without wildcards
+	bool ShortUnmasked(const std::vector<uint8_t>& mask, bool) {
+		return mask.size() <= 2 && std::all_of(mask.begin(), mask.end(), [](uint8_t m) { return m == 0xFF; });
+	}
+
+	bool ShortUnmaskedForward(const std::vector<uint8_t>& mask, bool forward) { return forward && ShortUnmasked(mask, forward); }
+
+	// Kernels without a reverse form fall back to findSignatureFast1 internally, which is what the backward numbers show for them
+	const Kernel kernels[] = {
+		{"findSignatureFast1", Always, AnyPattern,
+		 [](Scanner& scanner, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, const MemScanner::PatternAnchors& anchors, uintptr_t start,
+			uintptr_t end, bool forward) {
+			 return forward ? scanner.findSignatureFast1<true>(bytes, mask, anchors, start, end)
+							: scanner.findSignatureFast1<false>(bytes, mask, anchors, start, end);
+		 }},
+		{"findSignatureFast8", Always, AnyPattern,
+		 [](Scanner& scanner, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, const MemScanner::PatternAnchors&, uintptr_t start,
+			uintptr_t end, bool forward) {
+			 return forward ? scanner.findSignatureFast8<true>(bytes, mask, start, end) : scanner.findSignatureFast8<false>(bytes, mask, start, end);
+		 }},
+		{"findSignatureFastSSE", Always, AnyPattern,
+		 [](Scanner& scanner, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, const MemScanner::PatternAnchors& anchors, uintptr_t start,
+			uintptr_t end, bool forward) {
+			 return forward ? scanner.findSignatureFastSSE<true>(bytes, mask, anchors, start, end)
+							: scanner.findSignatureFastSSE<false>(bytes, mask, anchors, start, end);
+		 }},
+		{"findSignatureFastSSE42", Scanner::hasSSE42Support, AnyPattern,
+		 [](Scanner& scanner, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, const MemScanner::PatternAnchors&, uintptr_t start,
+			uintptr_t end, bool forward) {
+			 return forward ? scanner.findSignatureFastSSE42<true>(bytes, mask, start, end) : scanner.findSignatureFastSSE42<false>(bytes, mask, start, end);
+		 }},
+		{"findSignatureFastAVX2", Scanner::hasFullAVXSupport, AnyPattern,
+		 [](Scanner& scanner, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, const MemScanner::PatternAnchors& anchors, uintptr_t start,
+			uintptr_t end, bool forward) {
+			 return forward ? scanner.findSignatureFastAVX2<true>(bytes, mask, anchors, start, end)
+							: scanner.findSignatureFastAVX2<false>(bytes, mask, anchors, start, end);
+		 }},
+		// The public entry point including validation and kernel selection, without the search map
+		{"findSignatureInRange", Always, AnyPattern,
+		 [](Scanner& scanner, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, const MemScanner::PatternAnchors&, uintptr_t start,
+			uintptr_t end, bool forward) {
+			 return forward ? scanner.findSignatureInRange<true>(bytes, mask, start, end, false, false)
+							: scanner.findSignatureInRange<false>(bytes, mask, start, end, false, false);
+		 }},
+		{"findAllSignaturesInRange", Always, ForwardOnly,
+		 [](Scanner& scanner, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, const MemScanner::PatternAnchors&, uintptr_t start,
+			uintptr_t end, bool) {
+			 static std::vector<void*> matches;
+			 matches.clear();
+			 scanner.findAllSignaturesInRange(bytes, mask, start, end, matches, SIZE_MAX, false);
+			 return matches.empty() ? nullptr : matches[0];
+		 }},
+		{"std::find", Always, ShortUnmasked,
+		 [](Scanner&, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>&, const MemScanner::PatternAnchors&, uintptr_t start, uintptr_t end,
+			bool forward) -> void* {
+			 const auto *first = reinterpret_cast<const uint8_t*>(start), *last = reinterpret_cast<const uint8_t*>(end);
+			 const uint8_t* match = nullptr;
+			 if (bytes.size() == 1 && forward) {
+				 match = std::find(first, last, bytes[0]);
+			 } else if (bytes.size() == 1) {
+				 const auto it = std::find(std::make_reverse_iterator(last), std::make_reverse_iterator(first), bytes[0]);
+				 match = it.base() == first ? last : it.base() - 1;
+			 } else {
+				 match = forward ? std::search(first, last, bytes.begin(), bytes.end()) : std::find_end(first, last, bytes.begin(), bytes.end());
+			 }
+			 return match == last ? nullptr : const_cast<uint8_t*>(match);
+		 }},
+		{"memchr", Always, ShortUnmaskedForward,
+		 [](Scanner&, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>&, const MemScanner::PatternAnchors&, uintptr_t start, uintptr_t end,
+			bool) -> void* {
+			 // memmem style for two bytes: memchr for the first one, then check the second
+			 const auto* cur = reinterpret_cast<const uint8_t*>(start);
+			 const auto* last = reinterpret_cast<const uint8_t*>(end) - bytes.size();
+			 while (cur <= last) {
+				 const auto* match = static_cast<const uint8_t*>(memchr(cur, bytes[0], (size_t) (last - cur) + 1));
+				 if (match == nullptr) return nullptr;
+				 if (bytes.size() == 1 || match[1] == bytes[1]) return const_cast<uint8_t*>(match);
+				 cur = match + 1;
+			 }
+			 return nullptr;
+		 }},
+	};
+
+	struct Shape {
+		const char* name;
+		const char* signature;
+	};
+
+	const Shape shapes[] = {
+		{"short", "C3 0F 0B"},
+		{"long", "48 89 5C 24 08 48 89 74 24 10 57 48 83 EC 20 48 8B F9 48 8B 0D 11 22 33 44 E8 55 66 77 88 90 C3"},
+		{"wildcard-heavy", "48 ?? ?? ?? ?? 89 ?? ?? ?? ?? ?? E8 ?? ?? ?? ?? 85 ?? ?? 0F"},
+		{"common-anchor", "48 8B 00 00 48 89 00 00 00 00 FF FF"},
+		{"second-byte-masked", "E8 ?? 05 D1 7A 3C"},
+		{"nibble-masked", "4? 8B ?5 ?? ?? ?? ?? 4? 85 C?"},
+		// Padding and return scans. These bytes are everywhere in random data and code, so they are only measured on the sparse data
+		{"byte", "CC"},
+		{"byte-pair", "C3 CC"},
+		{"masked-byte", "C8&F8"},
+	};
+
+	struct DataSet {
+		std::string name;
+		uintptr_t start, end;
+	};
+
+	struct Result {
+		std::string kernel, shape, data, direction;
+		double mbPerS = 0;
+
+		std::string key() const { return kernel + "/" + shape + "/" + data + "/" + direction; }
+	};
+
+	// Changes the last fully known byte until the pattern no longer occurs in [start, end)
+	bool MakeImpossible(Scanner& scanner, std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, uintptr_t start, uintptr_t end) {
+		size_t last = mask.size() - 1;
+		while (last > 0 && mask[last] != 0xFF) last--;
+		for (int attempt = 0; attempt < 256; attempt++) {
+			if (scanner.findSignatureFast1<true>(bytes, mask, start, end) == nullptr) return true;
+			bytes[last] = (uint8_t) (bytes[last] + 1);
+		}
+		return false;
+	}
+
+	double Measure(const Kernel& kernel, Scanner& scanner, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, const DataSet& data,
+				   bool forward, double minSeconds) {
+		const auto anchors = Scanner::SelectAnchors(bytes, mask);
+		double best = 0;
+		// Best of several rounds, every round runs at least minSeconds
+		for (int round = 0; round < 3; round++) {
+			size_t numScans = 0;
+			uintptr_t useful = 0;
+			const auto start = std::chrono::steady_clock::now();
+			std::chrono::duration<double> elapsed{};
+			do {
+				useful += reinterpret_cast<uintptr_t>(kernel.scan(scanner, bytes, mask, anchors, data.start, data.end, forward));
+				numScans++;
+				elapsed = std::chrono::steady_clock::now() - start;
+			} while (elapsed.count() < minSeconds);
+			if (useful != 0) {
+				fprintf(stderr, "%s found a match that should not exist\n", kernel.name);
+				exit(2);
+			}
+			best = std::max(best, (double) (data.end - data.start) * (double) numScans / elapsed.count() / 1e6);
+		}
+		return best;
+	}
+
+	std::string Escape(const std::string& s) {
+		std::string out;
+		for (char c : s) {
+			if (c == '"' || c == '\\') out += '\\';
+			out += c;
+		}
+		return out;
+	}
+
+	void WriteJson(std::ostream& out, const std::vector<Result>& results, const std::vector<DataSet>& dataSets) {
+		out << "{\n\t\"avx2\": " << (Scanner::hasFullAVXSupport() ? "true" : "false") << ",\n";
+		out << "\t\"sse42\": " << (Scanner::hasSSE42Support() ? "true" : "false") << ",\n";
+		out << "\t\"data\": {";
+		for (size_t i = 0; i < dataSets.size(); i++) out << (i ? ", " : "") << '"' << Escape(dataSets[i].name) << "\": " << dataSets[i].end - dataSets[i].start;
+		out << "},\n\t\"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const auto& r = results[i];
+			char mbPerS[32];
+			snprintf(mbPerS, sizeof(mbPerS), "%.1f", r.mbPerS);
+			out << "\t\t{\"kernel\": \"" << Escape(r.kernel) << "\", \"shape\": \"" << Escape(r.shape) << "\", \"data\": \"" << Escape(r.data)
+				<< "\", \"direction\": \"" << r.direction << "\", \"mbPerS\": " << mbPerS << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+		}
+		out << "\t]\n}\n";
+	}
+
+	// Reads the objects of the "results" array of a file written by WriteJson. Only strings and numbers are expected as values
+	std::vector<Result> ReadJson(const std::string& path) {
+		std::ifstream in(path);
+		if (!in) {
+			fprintf(stderr, "could not open %s\n", path.c_str());
+			exit(2);
+		}
+		std::stringstream buffer;
+		buffer << in.rdbuf();
+		const auto text = buffer.str();
+
+		std::vector<Result> results;
+		auto pos = text.find("\"results\"");
+		if (pos == std::string::npos) return results;
+		auto readString = [&](size_t& p) {
+			std::string s;
+			for (p++; p < text.size() && text[p] != '"'; p++) {
+				if (text[p] == '\\' && p + 1 < text.size()) p++;
+				s += text[p];
+			}
+			p++;
+			return s;
+		};
+		while ((pos = text.find_first_of("{]", pos)) != std::string::npos && text[pos] == '{') {
+			Result r;
+			for (pos++; pos < text.size() && text[pos] != '}';) {
+				if (text[pos] != '"') {
+					pos++;
+					continue;
+				}
+				const auto key = readString(pos);
+				pos = text.find_first_not_of(" \t\r\n:", pos);
+				if (pos == std::string::npos) break;
+				if (text[pos] == '"') {
+					const auto value = readString(pos);
+					if (key == "kernel") r.kernel = value;
+					else if (key == "shape") r.shape = value;
+					else if (key == "data") r.data = value;
+					else if (key == "direction") r.direction = value;
+				} else {
+					char* numberEnd = nullptr;
+					const auto value = strtod(text.c_str() + pos, &numberEnd);
+					pos = (size_t) (numberEnd - text.c_str());
+					if (key == "mbPerS") r.mbPerS = value;
+				}
+			}
+			results.push_back(r);
+		}
+		return results;
+	}
+
+	// Returns the number of regressions
+	int Compare(const std::vector<Result>& baseline, const std::vector<Result>& results, double threshold) {
+		std::map<std::string, double> previous;
+		for (const auto& r : baseline) previous[r.key()] = r.mbPerS;
+		int numRegressions = 0;
+		printf("\n%-70s %12s %12s %8s\n", "benchmark", "baseline", "current", "change");
+		for (const auto& r : results) {
+			const auto it = previous.find(r.key());
+			if (it == previous.end() || it->second <= 0) {
+				printf("%-70s %12s %12.1f %8s\n", r.key().c_str(), "-", r.mbPerS, "new");
+				continue;
+			}
+			const auto change = (r.mbPerS / it->second - 1) * 100;
+			const bool regression = change < -threshold;
+			numRegressions += regression;
+			printf("%-70s %12.1f %12.1f %+7.1f%%%s\n", r.key().c_str(), it->second, r.mbPerS, change, regression ? "  REGRESSION" : "");
+		}
+		printf("%d regression(s) above %.1f%%\n", numRegressions, threshold);
+		return numRegressions;
+	}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+	const char* jsonPath = nullptr, *baselinePath = nullptr, *filter = nullptr;
+	double threshold = 10, minSeconds = 0.1;
+	size_t randomSize = 0x1000000;
+	for (int i = 1; i < argc; i++) {
+		const bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--quick") == 0) {
+			minSeconds = 0.01;
+			randomSize = 0x100000;
+		} else if (strcmp(argv[i], "--json") == 0 && hasValue) {
+			jsonPath = argv[++i];
+		} else if (strcmp(argv[i], "--compare") == 0 && hasValue) {
+			baselinePath = argv[++i];
+		} else if (strcmp(argv[i], "--threshold") == 0 && hasValue) {
+			threshold = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--filter") == 0 && hasValue) {
+			filter = argv[++i];
+		} else {
+			fprintf(stderr, "usage: %s [--quick] [--filter <text>] [--json <file>] [--compare <baseline.json>] [--threshold <percent>]\n", argv[0]);
+			return 2;
+		}
+	}
+	printf("AVX: %s\n", Scanner::hasFullAVXSupport() ? "enabled" : "unsupported");
+	printf("SSE4.2: %s\n", Scanner::hasSSE42Support() ? "enabled" : "unsupported");
+
+	std::vector<uint8_t> random(randomSize);
+	std::default_random_engine generator(1337);	 // predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	for (auto& b : random) b = (uint8_t) byteDist(generator);
+
+	// Random data without the bytes C0-CF, so the short patterns do not occur either
+	std::vector<uint8_t> sparse(random);
+	for (auto& b : sparse)
+		if ((b & 0xF0) == 0xC0) b ^= 0x20;
+
+	std::vector<DataSet> dataSets = {{"random", reinterpret_cast<uintptr_t>(random.data()), reinterpret_cast<uintptr_t>(random.data() + random.size())},
+									 {"sparse", reinterpret_cast<uintptr_t>(sparse.data()), reinterpret_cast<uintptr_t>(sparse.data() + sparse.size())}};
+	// Real compiler output: the code of this executable
+	const auto [textStart, textEnd] = MemScanner::Mem::GetSectionRange(MemScanner::Mem::FindModule(nullptr), ".text");
+	if (textEnd > textStart) dataSets.push_back({"text", (uintptr_t) textStart, (uintptr_t) textEnd});
+	else fprintf(stderr, "could not resolve .text, skipping code data\n");
+
+	Scanner scanner;
+	std::vector<Result> results;
+	for (const auto& data : dataSets) {
+		for (const auto& shape : shapes) {
+			auto [bytes, mask] = Scanner::ParseSignature(shape.signature);
+			if (!MakeImpossible(scanner, bytes, mask, data.start, data.end)) {
+				fprintf(stderr, "%s always occurs in %s, skipped\n", shape.name, data.name.c_str());
+				continue;
+			}
+			for (const auto& kernel : kernels) {
+				if (!kernel.supported()) continue;
+				for (bool forward : {true, false}) {
+					if (!kernel.accepts(mask, forward)) continue;
+					Result r{kernel.name, shape.name, data.name, forward ? "forward" : "backward", 0};
+					if (filter != nullptr && r.key().find(filter) == std::string::npos) continue;
+					r.mbPerS = Measure(kernel, scanner, bytes, mask, data, forward, minSeconds);
+					printf("%-70s %10.1f MB/s\n", r.key().c_str(), r.mbPerS);
+					fflush(stdout);
+					results.push_back(std::move(r));
+				}
+			}
+		}
+	}
+
+	if (jsonPath != nullptr) {
+		std::ofstream out(jsonPath);
+		WriteJson(out, results, dataSets);
+		if (!out) {
+			fprintf(stderr, "could not write %s\n", jsonPath);
+			return 2;
+		}
+	}
+	if (baselinePath != nullptr) return Compare(ReadJson(baselinePath), results, threshold) == 0 ? 0 : 1;
+	return 0;
+}
@@ -1,9 +1,16 @@
+#include <MemScanner/FileScanner.h>
+#include <MemScanner/Mem.h>
 #include <MemScanner/MemScanner.h>
+#include <MemScanner/RemoteProcess.h>
+#include <MemScanner/StreamScanner.h>
 
 #include <algorithm>
+#include <cstddef>
 #include <cstring>
+#include <future>
 #include <iostream>
 #include <random>
+#include <thread>
 
 #ifdef NDEBUG
 #undef NDEBUG
@@ -14,8 +21,12 @@
 #endif
 
 #ifdef _WIN32
-#include <MemScanner/Mem.h>
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #endif
 
 #include <filesystem>
@@ -28,21 +39,25 @@ unsigned char* knownGoodPatternSearch(const std::vector<uint8_t>& bytes, const s
 		assert(false);
 		return nullptr;
 	}
-	assert(mask.at(0) != 0);
 	auto* maskStart = mask.data();
 	auto* bytesStart = bytes.data();
-	auto startByte = reinterpret_cast<const uint8_t*>(bytesStart)[0];
 	const auto end = rangeEnd - bytes.size();
 	const auto patternSize = bytes.size();
+	// search for the first unmasked byte
+	const auto firstOff = (size_t) (std::find_if(mask.begin(), mask.end(), [](uint8_t m) { return m != 0; }) - mask.begin());
+	if (firstOff == patternSize) return (unsigned char*) rangeStart;
+	auto startMask = maskStart[firstOff];
+	auto startByte = (uint8_t) (bytesStart[firstOff] & startMask);
+	auto isStartByte = [=](uint8_t b) { return (b & startMask) == startByte; };
 
 	auto i = rangeStart;
 	while (i <= end) {
-		i = (uintptr_t) std::find(reinterpret_cast<uint8_t*>(i), reinterpret_cast<uint8_t*>(end + 1), startByte);
+		i = (uintptr_t) std::find_if(reinterpret_cast<uint8_t*>(i + firstOff), reinterpret_cast<uint8_t*>(end + firstOff + 1), isStartByte) - firstOff;
 		if (i == end + 1) break;
 
-		unsigned int off = 1;
+		unsigned int off = 0;
 		for (; off < patternSize; off++) {
-			if (*(uint8_t*) (i + off) != bytesStart[off] && maskStart[off] != 0) break;
+			if (((*(uint8_t*) (i + off) ^ bytesStart[off]) & maskStart[off]) != 0) break;
 		}
 		if (off == patternSize) return (unsigned char*) i;
 
@@ -51,6 +66,31 @@ unsigned char* knownGoodPatternSearch(const std::vector<uint8_t>& bytes, const s
 	return nullptr;
 }
 
+unsigned char* knownGoodPatternSearchReverse(const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask, uintptr_t rangeStart, uintptr_t rangeEnd) {
+	if (rangeStart + bytes.size() > rangeEnd) {
+		assert(false);
+		return nullptr;
+	}
+	const auto patternSize = bytes.size();
+	const auto firstOff = (size_t) (std::find_if(mask.begin(), mask.end(), [](uint8_t m) { return m != 0; }) - mask.begin());
+	if (firstOff == patternSize) return (unsigned char*) (rangeEnd - patternSize);
+
+	auto startMask = mask[firstOff];
+	auto startByte = (uint8_t) (bytes[firstOff] & startMask);
+	auto isStartByte = [=](uint8_t b) { return (b & startMask) == startByte; };
+	auto rbegin = std::make_reverse_iterator(reinterpret_cast<uint8_t*>(rangeEnd - patternSize + firstOff + 1));
+	auto rend = std::make_reverse_iterator(reinterpret_cast<uint8_t*>(rangeStart + firstOff));
+	for (auto it = std::find_if(rbegin, rend, isStartByte); it != rend; it = std::find_if(it + 1, rend, isStartByte)) {
+		auto i = (uintptr_t) &*it - firstOff;
+		unsigned int off = 0;
+		for (; off < patternSize; off++) {
+			if (((*(uint8_t*) (i + off) ^ bytes[off]) & mask[off]) != 0) break;
+		}
+		if (off == patternSize) return (unsigned char*) i;
+	}
+	return nullptr;
+}
+
 void testPatternAtEndOfBuffer(MemScanner::MemScanner& scanner, unsigned char* alloc, size_t allocSize) {
 	{  // without cache
 		volatile auto res = scanner.findSignatureInRange<true>("01 02 03 04", (uintptr_t) alloc, (uintptr_t) &alloc[allocSize], false);
@@ -154,10 +194,101 @@ double benchmarkScan(MemScanner::MemScanner& scanner, unsigned char* alloc, size
 	double microTimePerScan = (double) std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / (double) numIterations;
 	double msTimePerScan = microTimePerScan / 1000;
 	double mbPerS = (double) allocSize / microTimePerScan;
-	printf("On average %.2fms / scan, %.1fMB/s\n", msTimePerScan, mbPerS);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (i = 0; i < numIterations; i++)
+		useful += (uintptr_t) scanner.findSignatureInRange<false>(patternBytes, patternMask, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize], false, false);
+	end = std::chrono::high_resolution_clock::now();
+	assert(useful == 0);
+	double microTimePerBackwardScan = (double) std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / (double) numIterations;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (i = 0; i < numIterations; i++)
+		useful += (uintptr_t) scanner.findSignatureInRange<true>(MemScanner::Signature<"01 02 03 04 05 06 07 08 09 10 11 12">{}, (uintptr_t) alloc,
+																 (uintptr_t) &alloc[allocSize], false, false);
+	end = std::chrono::high_resolution_clock::now();
+	assert(useful == 0);
+	double microTimePerCompileTimeScan = (double) std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / (double) numIterations;
+
+	printf("On average %.2fms / scan, %.1fMB/s (backward %.2fms / scan, %.1fMB/s, compile time signature %.2fms / scan, %.1fMB/s)\n", msTimePerScan, mbPerS,
+		   microTimePerBackwardScan / 1000, (double) allocSize / microTimePerBackwardScan, microTimePerCompileTimeScan / 1000,
+		   (double) allocSize / microTimePerCompileTimeScan);
 	return mbPerS;
 }
 
+// Per call cost on small ranges, where parsing and setup dominate the scan itself
+void benchmarkCallOverhead() {
+	const char* sig = "48 8B 05 ?? ?? ?? ?? 48 85 C0";
+	std::vector<unsigned char> alloc(0x1000, 0xCC);
+	auto [patternBytes, patternMask] = MemScanner::MemScanner::ParseSignature(sig);
+	const MemScanner::MemScanner::Pattern prepared(sig);
+	MemScanner::MemScanner scanner;
+
+	const size_t numIterations = 200000;
+	auto measure = [&](auto&& scan) {
+		uintptr_t useful = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < numIterations; i++) useful += (uintptr_t) scan();
+		auto end = std::chrono::high_resolution_clock::now();
+		assert(useful == 0);
+		return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (double) numIterations;
+	};
+
+	for (size_t rangeSize : {16, 64, 256, 4096}) {
+		auto start = (uintptr_t) alloc.data(), end = start + rangeSize;
+		double stringNs = measure([&] { return scanner.findSignatureInRange<true>(sig, start, end, false, false); });
+		double vectorNs = measure([&] { return scanner.findSignatureInRange<true>(patternBytes, patternMask, start, end, false, false); });
+		double patternNs = measure([&] { return scanner.findSignatureInRange<true>(prepared, start, end, false, false); });
+		double compileTimeNs =
+			measure([&] { return scanner.findSignatureInRange<true>(MemScanner::Signature<"48 8B 05 ?? ?? ?? ?? 48 85 C0">{}, start, end, false, false); });
+		printf("%zd byte range: string %.0fns, vectors %.0fns, Pattern %.0fns, compile time signature %.0fns / call\n", rangeSize, stringNs, vectorNs,
+			   patternNs, compileTimeNs);
+	}
+}
+
+// Lookups that are answered by the search map, every thread resolves the same signatures at once
+void benchmarkCacheHits() {
+	std::default_random_engine generator(132);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	std::vector<unsigned char> alloc(0x10000);
+	for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+	const auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+
+	// 8 byte patterns copied out of the buffer, the cached range starts right at the match
+	std::vector<MemScanner::MemScanner::Pattern> patterns;
+	for (int i = 0; i < 16; i++) {
+		auto place = std::uniform_int_distribution<size_t>(0, alloc.size() - 8)(generator);
+		patterns.emplace_back(std::span<const uint8_t>(&alloc[place], 8), std::vector<uint8_t>(8, 0xFF));
+	}
+	MemScanner::MemScanner scanner;
+	for (const auto& pattern : patterns) scanner.findSignatureInRange<true>(pattern, start, end);
+	while (scanner.doSearchSingleMapKey()) {
+	}
+
+	const size_t numIterations = 20000;
+	const auto maxThreads = std::clamp(std::thread::hardware_concurrency(), 1u, 32u);
+	for (unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		std::atomic<bool> go = false;
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < numThreads; t++) {
+			threads.emplace_back([&] {
+				while (!go.load()) std::this_thread::yield();
+				uintptr_t useful = 0;
+				for (size_t i = 0; i < numIterations; i++)
+					useful += (uintptr_t) scanner.findSignatureInRange<true>(patterns[i % patterns.size()], start, end, true, false);
+				assert(useful != 0);
+			});
+		}
+		auto startTime = std::chrono::high_resolution_clock::now();
+		go = true;
+		for (auto& thread : threads) thread.join();
+		auto endTime = std::chrono::high_resolution_clock::now();
+		double seconds = (double) std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() / 1e6;
+		double lookups = (double) (numIterations * numThreads) / seconds;
+		printf("%u threads: %.2fM cached lookups/s (%.2fM per thread)\n", numThreads, lookups / 1e6, lookups / 1e6 / numThreads);
+	}
+}
+
 void benchmarkMultiThreadedScan(MemScanner::MemScanner& scanner, unsigned char* alloc, size_t allocSize, unsigned int numThreads) {
 	const char* impossibleSig = "01 02 03 04 05 06 07 08 09 10 11 12";
 	auto patternPair = MemScanner::MemScanner::ParseSignature(impossibleSig);
@@ -237,18 +368,147 @@ void benchmarkMultiThreadedScan(MemScanner::MemScanner& scanner, unsigned char*
 	printf("On average %.2fms / scan, %.1fMB/s\n", timePerScan, 1000. / timePerScan * ((double) allocSize / 1000000.));
 }
 
+void benchmarkParallelScan(MemScanner::MemScanner& scanner, unsigned char* alloc, size_t allocSize) {
+	const char* impossibleSig = "01 02 03 04 05 06 07 08 09 10 11 12";
+	const int numIters = 20;
+	scanner.evictCache();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < numIters; i++)
+		assert(scanner.findSignatureInRange<true>(impossibleSig, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize], false) == nullptr);
+	auto mid = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < numIters; i++)
+		assert(scanner.findSignatureInRangeParallel<true>(impossibleSig, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize], false) == nullptr);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double singleMs = (double) std::chrono::duration_cast<std::chrono::microseconds>(mid - start).count() / 1000 / numIters;
+	double parallelMs = (double) std::chrono::duration_cast<std::chrono::microseconds>(end - mid).count() / 1000 / numIters;
+	printf("single %.2fms / scan, parallel %.2fms / scan (%.1fx, %.1fMB/s)\n", singleMs, parallelMs, singleMs / std::max(parallelMs, 0.001),
+		   (double) allocSize / 1000. / std::max(parallelMs, 0.001));
+}
+
+void benchmarkBatchScan(MemScanner::MemScanner& scanner, unsigned char* alloc, size_t allocSize) {
+	const unsigned int numPatterns = 400;
+	std::default_random_engine generator(126);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+
+	// random 12 byte patterns, practically impossible to find
+	std::vector<MemScanner::MemScanner::ParsedSignature> patterns;
+	for (unsigned int i = 0; i < numPatterns; i++) {
+		std::vector<uint8_t> pattern(12), mask(12, 0xFF);
+		for (auto& b : pattern) b = (uint8_t) byteDist(generator);
+		patterns.emplace_back(pattern, mask);
+	}
+	scanner.evictCache();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	uintptr_t useful = 0;
+	for (const auto& [patternBytes, patternMask] : patterns)
+		useful += (uintptr_t) scanner.findSignatureInRange<true>(patternBytes, patternMask, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize], false, false);
+	auto mid = std::chrono::high_resolution_clock::now();
+	auto results = scanner.findSignaturesInRange(patterns, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize]);
+	auto end = std::chrono::high_resolution_clock::now();
+	for (auto* res : results) useful -= (uintptr_t) res;
+	assert(useful == 0);
+
+	double sequentialMs = (double) std::chrono::duration_cast<std::chrono::microseconds>(mid - start).count() / 1000;
+	double batchMs = (double) std::chrono::duration_cast<std::chrono::microseconds>(end - mid).count() / 1000;
+	printf("%u patterns: sequential %.2fms, batch %.2fms (%.1fx)\n", numPatterns, sequentialMs, batchMs, sequentialMs / std::max(batchMs, 0.001));
+}
+
+void testLeadingWildcards(MemScanner::MemScanner& scanner, unsigned char* alloc, size_t allocSize) {
+	auto [patternBytes, patternMask] = MemScanner::MemScanner::ParseSignature("?? ?? 02 03 ?? 05 ??");
+	assert(patternBytes.size() == 6);  // trailing wildcards are dropped, leading ones are kept
+	assert(patternMask[0] == 0 && patternMask[1] == 0 && patternMask[2] == 0xFF && patternMask[4] == 0);
+
+	const auto start = (uintptr_t) alloc, end = (uintptr_t) &alloc[allocSize];
+	std::vector<unsigned char> backup(alloc, alloc + 6);
+	alloc[2] = 0x02;
+	alloc[3] = 0x03;
+	alloc[5] = 0x05;
+	for (bool cache : {false, true}) {
+		assert(scanner.findSignatureInRange<true>("?? ?? 02 03 ?? 05 ??", start, end, cache) == alloc);
+		assert(scanner.findSignatureInRange<false>("?? ?? 02 03 ?? 05", start, start + 6, cache) == alloc);
+		// the anchor is two bytes into the pattern, so a match there would start before the range
+		assert(scanner.findSignatureInRange<true>("?? ?? 02 03", start + 1, start + 6, cache) == nullptr);
+		scanner.evictCache();
+	}
+	std::copy(backup.begin(), backup.end(), alloc);
+}
+
 void testBuffer(MemScanner::MemScanner& scanner, size_t allocSize, unsigned char* alloc) {
 	if (allocSize >= 4) {
 		testPatternAtEndOfBuffer(scanner, alloc, allocSize);
 		testPatternAtStartOfBuffer(scanner, alloc, allocSize);
 	}
+	if (allocSize >= 8) testLeadingWildcards(scanner, alloc, allocSize);
 	printf("Tests success! (Allocation size: %zd)\n", allocSize);
 }
 
+// A warm start hashes the range once to validate a saved search map, this has to stay well below the cost of a scan
+void benchmarkHashRange(unsigned char* alloc, size_t allocSize) {
+	const size_t numIterations = std::clamp((size_t) 2000000000 / (allocSize + 1), (size_t) 5, (size_t) 1000000);
+	uint64_t useful = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < numIterations; i++) useful += MemScanner::MemScanner::HashRange((uintptr_t) alloc, (uintptr_t) alloc + allocSize);
+	auto end = std::chrono::high_resolution_clock::now();
+	double microTimePerHash = (double) std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / (double) numIterations;
+	printf("Range hash: %.3fms, %.1fMB/s (%llx)\n", microTimePerHash / 1000, (double) allocSize / microTimePerHash, (unsigned long long) useful);
+}
+
+// Index backed lookups against linear scans of the same range
+void benchmarkIndex(unsigned char* alloc, size_t allocSize) {
+	if (allocSize < 0x100) return;
+	MemScanner::MemScanner scanner;
+	auto start = (uintptr_t) alloc, end = start + allocSize;
+	auto buildStart = std::chrono::high_resolution_clock::now();
+	auto index = scanner.buildIndex(start, end);
+	auto buildEnd = std::chrono::high_resolution_clock::now();
+	printf("Index build: %.3fms, %.1fMB memory (%.1f bytes / byte)\n",
+		   (double) std::chrono::duration_cast<std::chrono::microseconds>(buildEnd - buildStart).count() / 1000, (double) index->memoryUsage() / 1e6,
+		   (double) index->memoryUsage() / (double) allocSize);
+
+	// Signatures taken from the buffer, with wildcards after the first 4 bytes
+	std::default_random_engine generator(97);  // predictable seed
+	std::uniform_int_distribution<size_t> offsetDist(0, allocSize - 16);
+	std::vector<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>> patterns;
+	for (int i = 0; i < 64; i++) {
+		auto offset = offsetDist(generator);
+		std::vector<uint8_t> bytes(alloc + offset, alloc + offset + 12), mask(12, 0xFF);
+		for (size_t j = 4; j < bytes.size(); j += 3) bytes[j] = mask[j] = 0;
+		patterns.emplace_back(std::move(bytes), std::move(mask));
+	}
+
+	auto measure = [&](size_t numIterations, auto&& scan) {
+		uintptr_t useful = 0;
+		auto t0 = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < numIterations; i++) useful += (uintptr_t) scan(patterns[i % patterns.size()]);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		assert(useful != 0);
+		return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / (double) numIterations;
+	};
+	const auto numLinear = std::clamp((size_t) 2000000000 / allocSize, (size_t) 64, (size_t) 100000);
+	double linearNs = measure(numLinear, [&](const auto& p) { return scanner.findSignatureFastAVX2<true>(p.first, p.second, start, end); });
+	double indexNs = measure(200000, [&](const auto& p) { return scanner.findSignatureInRange<true>(p.first, p.second, start, end, false, false); });
+	printf("Indexed lookup: %.0fns, linear %.0fns (%.1fx)\n", indexNs, linearNs, linearNs / indexNs);
+}
+
 void benchmarkBuffer(MemScanner::MemScanner& scanner, size_t allocSize, unsigned char* alloc, const std::string& type) {
 	printf("Benchmarking single threaded %s performance...\n", type.c_str());
 	for (int i = 0; i < 10; i++) benchmarkScan(scanner, alloc, allocSize);
 
+	printf("Benchmarking batch %s performance...\n", type.c_str());
+	for (int i = 0; i < 3; i++) benchmarkBatchScan(scanner, alloc, allocSize);
+
+	printf("Benchmarking %s hashing performance...\n", type.c_str());
+	for (int i = 0; i < 3; i++) benchmarkHashRange(alloc, allocSize);
+	benchmarkIndex(alloc, allocSize);
+
+	if (allocSize >= MemScanner::MemScanner::parallelScanThreshold) {
+		printf("Benchmarking built-in parallel %s performance...\n", type.c_str());
+		for (int i = 0; i < 5; i++) benchmarkParallelScan(scanner, alloc, allocSize);
+	}
+
 	printf("Benchmarking multi threaded %s performance...\n", type.c_str());
 	auto maxThreads = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 64u);
 	unsigned int curNThreads = 2;
@@ -326,8 +586,13 @@ void testRandomSyntheticBufferSize() {
 			for (size_t i = (patternSize & (~7u)); i < patternSize; i++) pattern[i] = (unsigned char) distribution(generator);
 
 			if (r > 1000) {
-				for (size_t i = 1; i < patternSize; i++)
+				for (size_t i = 0; i < patternSize; i++)
 					if (binDist(generator) == 1) mask[i] = 0;
+				if (r % 5 == 0) {  // nibble and bit masks
+					for (size_t i = 0; i < patternSize; i++)
+						if (mask[i] != 0 && binDist(generator) == 1) mask[i] = (uint8_t) distribution(generator);
+				}
+				if (std::all_of(mask.begin(), mask.end(), [](uint8_t m) { return m == 0; })) mask[patternSize - 1] = 0xFF;
 			}
 			assert(pattern.size() == mask.size());
 
@@ -354,6 +619,34 @@ void testRandomSyntheticBufferSize() {
 
 					assert(false);
 				}
+				if (!testCache) {
+					// the vector kernels have to agree no matter which one is picked at runtime
+					assert((uintptr_t) scanner.findSignatureFastSSE<true>(pattern, mask, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize]) == goodFind);
+					if (MemScanner::MemScanner::hasSSE42Support())
+						assert((uintptr_t) scanner.findSignatureFastSSE42<true>(pattern, mask, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize]) == goodFind);
+				}
+
+				if (r % 4 == 0) {  // backward searches are checked on a subset to keep the runtime in check
+					auto goodReverseFind = (uintptr_t) knownGoodPatternSearchReverse(pattern, mask, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize]);
+					auto ourReverseFind =
+						(uintptr_t) scanner.findSignatureInRange<false>(pattern, mask, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize], testCache, testCache);
+					if (goodReverseFind != ourReverseFind) {
+						fprintf(stderr, "\nBackward mismatch: %zX != %zX (alloc size %zd, pattern size %zd)\n", goodReverseFind, ourReverseFind, allocSize,
+								pattern.size());
+						assert(false);
+					}
+					if (!testCache)
+						assert((uintptr_t) scanner.findSignatureFastSSE<false>(pattern, mask, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize]) ==
+							   goodReverseFind);
+
+					const MemScanner::MemScanner::Pattern prepared(pattern, mask);
+					assert((uintptr_t) prepared.bytes().data() % MemScanner::MemScanner::Pattern::alignment == 0);
+					assert((uintptr_t) prepared.mask().data() % MemScanner::MemScanner::Pattern::alignment == 0);
+					assert((uintptr_t) scanner.findSignatureInRange<true>(prepared, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize], testCache, testCache) ==
+						   goodFind);
+					assert((uintptr_t) scanner.findSignatureInRange<false>(prepared, (uintptr_t) alloc, (uintptr_t) &alloc[allocSize], testCache, testCache) ==
+						   goodReverseFind);
+				}
 				if (goodFind != 0 || testCache) break;
 
 				// Place the pattern somewhere in the buffer
@@ -371,38 +664,1272 @@ void testRandomSyntheticBufferSize() {
 	}
 }
 
+void testBatchSearch() {
+	const int numIterations = 100;
+
+	std::default_random_engine generator(125);	// predictable seed
+	std::uniform_int_distribution<uint64_t> distribution(0, 0xFFFFFFFFFFFFFFFF);
+	std::uniform_int_distribution<size_t> sizeDistribution(1, 0x8000);
+	std::uniform_int_distribution<size_t> patternSizeDistribution(1, 24);
+	std::uniform_int_distribution<int> percentDist(0, 99);
+
+	for (int e = 0; e < numIterations; e++) {
+		auto allocSize = e < 64 ? (size_t) e + 1 : sizeDistribution(generator);
+		std::vector<unsigned char> alloc(allocSize);
+		for (auto& b : alloc) b = (unsigned char) distribution(generator);
+
+		std::vector<MemScanner::MemScanner::ParsedSignature> patterns;
+		const int numPatterns = e % 2 == 0 ? 300 : 6;  // few patterns keep the nibble prefilter selective
+		for (int r = 0; r < numPatterns; r++) {
+			auto patternSize = std::min(patternSizeDistribution(generator), allocSize);
+			std::vector<uint8_t> pattern(patternSize), mask(patternSize, 0xFF);
+			// Copy half of the patterns out of the buffer so they are found
+			auto place = std::uniform_int_distribution<size_t>(0, allocSize - patternSize)(generator);
+			bool fromBuffer = percentDist(generator) < 50;
+			for (size_t i = 0; i < patternSize; i++) pattern[i] = fromBuffer ? alloc[place + i] : (uint8_t) distribution(generator);
+			for (size_t i = 0; i < patternSize; i++) {
+				const auto percent = percentDist(generator);
+				if (percent < 20)
+					mask[i] = 0;
+				else if (percent < 30)
+					mask[i] = (uint8_t) distribution(generator);
+			}
+			if (std::all_of(mask.begin(), mask.end(), [](uint8_t m) { return m == 0; })) mask[0] = 0xFF;
+			patterns.emplace_back(pattern, mask);
+		}
+
+		MemScanner::MemScanner scanner;
+		auto start = (uintptr_t) alloc.data(), end = (uintptr_t) alloc.data() + allocSize;
+		auto results = scanner.findSignaturesInRange(patterns, start, end);
+		assert(results.size() == patterns.size());
+		for (size_t i = 0; i < patterns.size(); i++) {
+			auto goodFind = knownGoodPatternSearch(patterns[i].first, patterns[i].second, start, end);
+			if (results[i] != goodFind) {
+				fprintf(stderr, "\nBatch mismatch for pattern %zd: %p != %p (alloc %p size %zd)\n", i, (void*) goodFind, results[i], alloc.data(), allocSize);
+				assert(false);
+			}
+		}
+	}
+	printf("Batch tests success!\n");
+}
+
+void testFindAll() {
+	const int numIterations = 200;
+
+	std::default_random_engine generator(126);	// predictable seed
+	std::uniform_int_distribution<size_t> sizeDistribution(1, 0x2000);
+	std::uniform_int_distribution<size_t> patternSizeDistribution(1, 8);
+	std::uniform_int_distribution<int> byteDist(0, 3);	// low entropy so patterns match many times
+	std::uniform_int_distribution<int> percentDist(0, 99);
+
+	MemScanner::MemScanner scanner;
+	for (int e = 0; e < numIterations; e++) {
+		auto allocSize = sizeDistribution(generator);
+		std::vector<unsigned char> alloc(allocSize);
+		for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+
+		auto patternSize = std::min(patternSizeDistribution(generator), allocSize);
+		std::vector<uint8_t> pattern(patternSize), mask(patternSize, 0xFF);
+		for (size_t i = 0; i < patternSize; i++) {
+			pattern[i] = (uint8_t) byteDist(generator);
+			if (percentDist(generator) < 20) mask[i] = 0;
+		}
+		if (std::find(mask.begin(), mask.end(), 0xFF) == mask.end()) mask[patternSize - 1] = 0xFF;
+
+		auto start = (uintptr_t) alloc.data(), end = (uintptr_t) alloc.data() + allocSize;
+		std::vector<void*> expected;
+		for (auto cur = start; cur + patternSize <= end;) {
+			auto* found = knownGoodPatternSearch(pattern, mask, cur, end);
+			if (found == nullptr) break;
+			expected.push_back(found);
+			cur = (uintptr_t) found + 1;
+		}
+
+		std::vector<void*> results;
+		auto numFound = scanner.findAllSignaturesInRange(pattern, mask, start, end, results, SIZE_MAX, e % 2 == 0);
+		assert(numFound == expected.size());
+		assert(results == expected);
+
+		// Lazy iteration stops after the limit
+		const size_t limit = e % 7;
+		std::vector<void*> lazy;
+		for (auto* match : scanner.iterateSignatureInRange(pattern, mask, start, end, limit, false)) lazy.push_back(match);
+		assert(lazy.size() == std::min(limit, expected.size()));
+		assert(std::equal(lazy.begin(), lazy.end(), expected.begin()));
+
+		// The SSE phase a cursor takes on CPUs without AVX2
+		MemScanner::MemScanner::ScanCursor cursor(start);
+		cursor.anchors = MemScanner::MemScanner::SelectAnchors(pattern, mask);
+		cursor.phase = cursor.anchors.count > 0 ? MemScanner::MemScanner::ScanCursor::Phase::VectorSSE : MemScanner::MemScanner::ScanCursor::Phase::Scalar;
+		std::vector<void*> resumed;
+		while (auto* match = scanner.findNextSignatureFastAVX2(pattern, mask, end, cursor)) resumed.push_back(match);
+		assert(resumed == expected);
+
+		void* buffer[4];
+		numFound = scanner.findAllSignaturesInRange(pattern, mask, start, end, buffer, 4, false);
+		assert(numFound == std::min<size_t>(4, expected.size()));
+		assert(std::equal(buffer, buffer + numFound, expected.begin()));
+
+		MemScanner::MemScanner::Pattern prepared(pattern, mask);
+		numFound = scanner.findAllSignaturesInRange(prepared, start, end, buffer, 4, e % 2 == 0);
+		assert(numFound == std::min<size_t>(4, expected.size()));
+		assert(std::equal(buffer, buffer + numFound, expected.begin()));
+
+		// A moved-from pattern is empty, can be copied and assigned to and throws when scanned for
+		MemScanner::MemScanner::Pattern moved(std::move(prepared));
+		assert(prepared.size() == 0 && prepared.bytes().empty() && prepared.mask().empty() && prepared.searchMapWindows().empty());
+		assert(MemScanner::MemScanner::Pattern(prepared).size() == 0);
+		bool thrown = false;
+		try {
+			scanner.findAllSignaturesInRange(prepared, start, end, buffer, 4, e % 2 == 0);
+		} catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		assert(thrown);
+		prepared = std::move(moved);
+		assert(moved.size() == 0 && prepared.size() == patternSize);
+		numFound = scanner.findAllSignaturesInRange(prepared, start, end, buffer, 4, false);
+		assert(numFound == std::min<size_t>(4, expected.size()));
+		assert(std::equal(buffer, buffer + numFound, expected.begin()));
+	}
+	printf("Find all tests success!\n");
+}
+
+void testParallelSearch() {
+	const size_t allocSize = MemScanner::MemScanner::parallelScanThreshold + 3 * MemScanner::MemScanner::parallelScanChunkSize / 2;
+	std::vector<unsigned char> alloc(allocSize);
+	std::default_random_engine generator(127);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+
+	MemScanner::MemScanner scanner;
+	scanner.setParallelScanThreads(4);	// also run on more than one thread on single core machines
+	const auto start = (uintptr_t) alloc.data(), end = start + allocSize;
+	const char* sig = "4D 65 6D ?? 63 61 6E 6E 65 72";
+	auto [patternBytes, patternMask] = MemScanner::MemScanner::ParseSignature(sig);
+	auto check = [&]() {
+		for (bool cache : {false, true}) {
+			assert(scanner.findSignatureInRangeParallel<true>(sig, start, end, cache) == scanner.findSignatureInRange<true>(sig, start, end, false));
+			assert(scanner.findSignatureInRangeParallel<false>(sig, start, end, cache) == scanner.findSignatureInRange<false>(sig, start, end, false));
+			scanner.evictCache();
+		}
+	};
+	check();  // not found
+
+	// matches straddling chunk borders, the lowest and highest one have to win
+	const size_t chunk = MemScanner::MemScanner::parallelScanChunkSize;
+	for (size_t place : {allocSize - patternBytes.size(), chunk * 9 - 4, chunk * 2 - 1, chunk * 17 - 5, (size_t) 0}) {
+		for (size_t i = 0; i < patternBytes.size(); i++)
+			if (patternMask[i] != 0) alloc[place + i] = patternBytes[i];
+		check();
+	}
+	printf("Parallel tests success!\n");
+}
+
+template <class Sig>
+void testCompileTimeSignature(MemScanner::MemScanner& scanner, const char* szSignature, std::default_random_engine& generator) {
+	const auto [patternBytes, patternMask] = MemScanner::MemScanner::ParseSignature(szSignature);
+	assert(std::equal(Sig::bytes.begin(), Sig::bytes.end(), patternBytes.begin(), patternBytes.end()));
+	assert(std::equal(Sig::mask.begin(), Sig::mask.end(), patternMask.begin(), patternMask.end()));
+
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	std::uniform_int_distribution<size_t> sizeDist(Sig::size, 0x400);
+	for (int e = 0; e < 200; e++) {
+		std::vector<unsigned char> alloc(sizeDist(generator));
+		for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+		// plant a few matches
+		for (int i = 0; i < e % 4; i++) {
+			auto place = std::uniform_int_distribution<size_t>(0, alloc.size() - Sig::size)(generator);
+			for (size_t k = 0; k < Sig::size; k++)
+				if (Sig::mask[k] != 0) alloc[place + k] = Sig::bytes[k];
+		}
+
+		const auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+		const bool cache = e % 2 == 0;
+		assert(scanner.findSignatureInRange<true>(Sig{}, start, end, cache) == scanner.findSignatureInRange<true>(szSignature, start, end, false));
+		assert(scanner.findSignatureInRange<false>(Sig{}, start, end, cache) == scanner.findSignatureInRange<false>(szSignature, start, end, false));
+		assert((MemScanner::detail::FindSignatureSSE2<Sig, true>(start, end) == scanner.findSignatureInRange<true>(szSignature, start, end, false)));
+		assert((MemScanner::detail::FindSignatureSSE2<Sig, false>(start, end) == scanner.findSignatureInRange<false>(szSignature, start, end, false)));
+		if (cache) scanner.evictCache();
+	}
+}
+
+void testCompileTimeSignatures() {
+	using MemScanner::Signature;
+	using Sig1 = Signature<"48 8B 05 ?? ?? ?? ?? 48">;
+	static_assert(Sig1::size == 8 && Sig1::bytes[1] == 0x8B && Sig1::mask[3] == 0 && Sig1::mask[7] == 0xFF);
+	static_assert(Signature<"?? e8 ?? ??">::size == 2);	 // leading wildcards are kept, trailing ones are dropped
+	static_assert(Signature<"C3">::anchors.count == 1);
+
+	std::default_random_engine generator(128);	// predictable seed
+	MemScanner::MemScanner scanner;
+	testCompileTimeSignature<Sig1>(scanner, "48 8B 05 ?? ?? ?? ?? 48", generator);
+	testCompileTimeSignature<Signature<"?? e8 ?? ??">>(scanner, "?? e8 ?? ??", generator);
+	testCompileTimeSignature<Signature<"C3">>(scanner, "C3", generator);
+	testCompileTimeSignature<Signature<"40 53 48 83 EC ? 48 8B D9 E8 ? ? ? ? 48 8B 0D">>(scanner, "40 53 48 83 EC ? 48 8B D9 E8 ? ? ? ? 48 8B 0D", generator);
+	printf("Compile time signature tests success!\n");
+}
+
+void testMaskedSignatures() {
+	using Parsed = MemScanner::MemScanner::ParsedSignature;
+	assert(MemScanner::MemScanner::ParseSignature("4? ?5 C7&F8 ?? 8B") == Parsed({0x40, 0x05, 0xC0, 0x00, 0x8B}, {0xF0, 0x0F, 0xF8, 0x00, 0xFF}));
+	assert(MemScanner::MemScanner::ParseSignature("?? 4?&C0 ??") == Parsed({0x00, 0x40}, {0x00, 0xC0}));
+	for (const char* malformed : {"4", "ZZ", "8B&", "8B&F", "G?"}) {
+		bool thrown = false;
+		try {
+			MemScanner::MemScanner::ParseSignature(malformed);
+		} catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	using MemScanner::Signature;
+	using Sig1 = Signature<"48 8B 4? ?? ?? ?? ?? E8&F8">;
+	static_assert(Sig1::size == 8 && Sig1::mask[2] == 0xF0 && Sig1::bytes[7] == 0xE8 && Sig1::mask[7] == 0xF8);
+	static_assert(Signature<"?5 ??">::size == 1 && Signature<"?5 ??">::mask[0] == 0x0F && Signature<"?5 ??">::anchors.partial);
+
+	// Partially masked anchors only, every kernel has to AND before comparing
+	const auto [partialBytes, partialMask] = MemScanner::MemScanner::ParseSignature("4? ?5 C?&E0 ?8");
+	assert(MemScanner::MemScanner::SelectAnchors(partialBytes, partialMask).partial);
+
+	std::default_random_engine generator(129);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	MemScanner::MemScanner scanner;
+	for (int e = 0; e < 200; e++) {
+		std::vector<unsigned char> alloc(std::uniform_int_distribution<size_t>(4, 0x1000)(generator));
+		for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+		const auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+		const bool cache = e % 2 == 0;
+
+		auto goodFind = knownGoodPatternSearch(partialBytes, partialMask, start, end);
+		assert(scanner.findSignatureInRange<true>(partialBytes, partialMask, start, end, cache) == goodFind);
+		assert(scanner.findSignatureFastSSE<true>(partialBytes, partialMask, start, end) == goodFind);
+		assert(scanner.findSignatureFast1<true>(partialBytes, partialMask, start, end) == goodFind);
+		assert(scanner.findSignatureInRange<false>(partialBytes, partialMask, start, end, cache) ==
+			   knownGoodPatternSearchReverse(partialBytes, partialMask, start, end));
+		assert(scanner.findSignatureInRange<true>(Signature<"4? ?5 C?&E0 ?8">{}, start, end, false) == goodFind);
+
+		std::vector<void*> all;
+		scanner.findAllSignaturesInRange(partialBytes, partialMask, start, end, all, SIZE_MAX, false);
+		for (auto* match : all) assert(knownGoodPatternSearch(partialBytes, partialMask, (uintptr_t) match, end) == match);
+		if (cache) scanner.evictCache();
+	}
+
+	std::default_random_engine sigGenerator(130);
+	testCompileTimeSignature<Sig1>(scanner, "48 8B 4? ?? ?? ?? ?? E8&F8", sigGenerator);
+	testCompileTimeSignature<Signature<"?5 ?? 0F&0F ?? 8?">>(scanner, "?5 ?? 0F&0F ?? 8?", sigGenerator);
+	printf("Masked signature tests success!\n");
+}
+
+void testCandidateVerification() {
+	using MemScanner::Signature;
+	static_assert(Signature<"48 8B 05 ?? ?? ?? ?? 48">::anchors.filterSize == 8 && Signature<"48 8B 05 ?? ?? ?? ?? 48">::anchors.filterOffset == 0);
+	static_assert(Signature<"01 02 03 04 05">::anchors.filterSize == 4 && Signature<"C3">::anchors.filterSize == 0);
+	static_assert(Signature<"?? ?? ?? ?? ?? ?? ?? ?? ?? E8 01 02 03 ?? ?? ?? ?? ?? ??">::anchors.filterOffset >= 2);
+
+	// Every copy of the pattern differs from it in a single byte, so all of them pass the anchors and the filter window
+	// and have to be rejected by the verification, in the first block, the overlapping last block or behind the vectorized part
+	std::default_random_engine generator(277);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	MemScanner::MemScanner scanner;
+	for (const unsigned int patternSize : {3u, 5u, 8u, 9u, 15u, 16u, 17u, 31u, 32u, 33u, 63u, 64u, 100u, 128u, 255u, 256u, 257u, 300u}) {
+		for (int e = 0; e < 6; e++) {
+			std::vector<uint8_t> bytes(patternSize), mask(patternSize, 0xFF);
+			for (auto& b : bytes) b = (uint8_t) byteDist(generator);
+			for (unsigned int i = 1; e % 2 == 1 && i < patternSize; i += 1 + byteDist(generator) % 7) mask[i] = i % 3 ? 0x00 : 0xF0;
+
+			std::vector<unsigned char> alloc(0x8000);
+			for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+			std::uniform_int_distribution<size_t> offsetDist(0, patternSize - 1);
+			for (size_t pos = byteDist(generator) % 64; pos + patternSize <= alloc.size(); pos += patternSize + byteDist(generator) % 48) {
+				memcpy(&alloc[pos], bytes.data(), patternSize);
+				auto off = offsetDist(generator);
+				if (mask[off] == 0) off = patternSize - 1;
+				alloc[pos + off] ^= (unsigned char) (~mask[off] & 0x01 ? 0x80 : 0x01);
+			}
+			if (e >= 2) {
+				const auto pos = (size_t) byteDist(generator) * 8 % (alloc.size() - patternSize);
+				memcpy(&alloc[pos], bytes.data(), patternSize);
+			}
+			const auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+
+			const auto* expected = knownGoodPatternSearch(bytes, mask, start, end);
+			assert(scanner.findSignatureFastAVX2<true>(bytes, mask, start, end) == expected);
+			assert(scanner.findSignatureFastAVX2<false>(bytes, mask, start, end) == knownGoodPatternSearchReverse(bytes, mask, start, end));
+			std::vector<void*> all;
+			scanner.findAllSignaturesInRange(bytes, mask, start, end, all, SIZE_MAX, false);
+			size_t numExpected = 0;
+			for (auto cur = start; cur + patternSize <= end; numExpected++) {
+				auto* match = knownGoodPatternSearch(bytes, mask, cur, end);
+				if (match == nullptr) break;
+				assert(numExpected < all.size() && all[numExpected] == match);
+				cur = (uintptr_t) match + 1;
+			}
+			assert(all.size() == numExpected && (e < 2 || numExpected > 0));
+		}
+	}
+	printf("Candidate verification tests success!\n");
+}
+
+void testShortPatterns() {
+	std::default_random_engine generator(281);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	MemScanner::MemScanner scanner;
+	const char* signatures[] = {"CC", "C3", "CC CC", "?? E8", "C?", "0F 8?", "?1&0F CC"};
+	for (const char* szSignature : signatures) {
+		const auto [bytes, mask] = MemScanner::MemScanner::ParseSignature(szSignature);
+		for (int e = 0; e < 80; e++) {
+			// Sparse matches, including none at all, in ranges that start and end anywhere within a block
+			std::vector<unsigned char> alloc(std::uniform_int_distribution<size_t>(1, e < 40 ? 200 : 0x3000)(generator));
+			for (auto& b : alloc) b = (unsigned char) (byteDist(generator) | 0x10);
+			const auto numPlanted = e % 4 == 0 ? 0 : byteDist(generator) % 8;
+			for (unsigned int i = 0; i < numPlanted && alloc.size() >= bytes.size(); i++) {
+				const auto pos = std::uniform_int_distribution<size_t>(0, alloc.size() - bytes.size())(generator);
+				for (size_t b = 0; b < bytes.size(); b++) alloc[pos + b] = (unsigned char) ((alloc[pos + b] & ~mask[b]) | (bytes[b] & mask[b]));
+			}
+			const auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+			if (alloc.size() < bytes.size()) continue;
+
+			auto* expected = knownGoodPatternSearch(bytes, mask, start, end);
+			auto* expectedReverse = knownGoodPatternSearchReverse(bytes, mask, start, end);
+			assert(scanner.findSignatureFastAVX2<true>(bytes, mask, start, end) == expected);
+			assert(scanner.findSignatureFastAVX2<false>(bytes, mask, start, end) == expectedReverse);
+			assert(scanner.findSignatureFastSSE<true>(bytes, mask, start, end) == expected);
+			assert(scanner.findSignatureFastSSE<false>(bytes, mask, start, end) == expectedReverse);
+			assert(scanner.findSignatureInRange<true>(bytes, mask, start, end, false) == expected);
+
+			std::vector<void*> all;
+			scanner.findAllSignaturesInRange(bytes, mask, start, end, all, SIZE_MAX, false);
+			size_t numExpected = 0;
+			for (auto cur = start; cur + bytes.size() <= end; numExpected++) {
+				auto* match = knownGoodPatternSearch(bytes, mask, cur, end);
+				if (match == nullptr) break;
+				assert(numExpected < all.size() && all[numExpected] == match);
+				cur = (uintptr_t) match + 1;
+			}
+			assert(all.size() == numExpected);
+		}
+	}
+
+	// A padding run matches at every position
+	std::vector<unsigned char> padding(0x100, 0xCC);
+	std::vector<void*> all;
+	const auto start = (uintptr_t) padding.data();
+	assert(scanner.findAllSignaturesInRange("CC CC", start, start + padding.size(), all, SIZE_MAX, false) == padding.size() - 1);
+	assert(scanner.findSignatureInRange<false>("CC", start, start + padding.size(), false) == &padding.back());
+	printf("Short pattern tests success!\n");
+}
+
+void testSearchMapPersistence() {
+	std::default_random_engine generator(131);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	std::vector<unsigned char> alloc(0x20000);
+	for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+	const std::vector<const char*> signatures = {"48 8B 05", "E8 ?? ?? ?? ?? 90", "4? 8B C?", "01 02 03 04 05"};
+	auto cacheFile = fs::temp_directory_path() / "MemScannerTest.searchmap";
+
+	size_t numSaved = 0;
+	{
+		MemScanner::MemScanner scanner;
+		auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+		for (auto* sig : signatures) scanner.findSignatureInRange<true>(sig, start, end);
+		while (scanner.doSearchSingleMapKey()) {
+		}
+		numSaved = scanner.saveSearchMap(cacheFile, start, end);
+		assert(numSaved > 0);
+	}
+
+	// Same content at a different address, entries are rebased
+	std::vector<unsigned char> copy(alloc);
+	auto start = (uintptr_t) copy.data(), end = start + copy.size();
+	MemScanner::MemScanner warm;
+	assert(warm.loadSearchMap(cacheFile, start, end));
+	assert(warm.saveSearchMap(cacheFile.string() + ".2", start, end) == numSaved);
+	for (auto* sig : signatures) {
+		auto [bytes, mask] = MemScanner::MemScanner::ParseSignature(sig);
+		assert(warm.findSignatureInRange<true>(sig, start, end, true, false) == knownGoodPatternSearch(bytes, mask, start, end));
+		assert(warm.findSignatureInRange<false>(sig, start, end, true, false) == knownGoodPatternSearchReverse(bytes, mask, start, end));
+	}
+
+	// Stale or broken caches are rejected
+	MemScanner::MemScanner cold;
+	copy[0x1234] ^= 1;
+	assert(!cold.loadSearchMap(cacheFile, start, end));
+	copy[0x1234] ^= 1;
+	assert(!cold.loadSearchMap(cacheFile, start, end - 1));
+	assert(!cold.loadSearchMap(cacheFile.string() + ".missing", start, end));
+	{
+		// An entry count the file does not hold is rejected before anything is allocated for it
+		std::fstream doctored(cacheFile.string() + ".2", std::ios::binary | std::ios::in | std::ios::out);
+		const uint32_t numEntries = UINT32_MAX;
+		doctored.seekp(offsetof(MemScanner::MemScanner::SearchMapFileHeader, numEntries));
+		doctored.write((const char*) &numEntries, sizeof(numEntries));
+	}
+	assert(!cold.loadSearchMap(cacheFile.string() + ".2", start, end));
+	fs::resize_file(cacheFile, fs::file_size(cacheFile) - 1);
+	assert(!cold.loadSearchMap(cacheFile, start, end));
+	assert(cold.saveSearchMap(cacheFile, start, end) == 0);
+
+	fs::remove(cacheFile);
+	fs::remove(cacheFile.string() + ".2");
+	printf("Search map persistence tests success!\n");
+}
+
+void testResultCache() {
+	std::vector<unsigned char> alloc(0x10000, 0x90);
+	auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+	alloc[0x100] = 0x48, alloc[0x101] = 0x8B, alloc[0x102] = 0x05;
+	alloc[0x8000] = 0x48, alloc[0x8001] = 0x8B, alloc[0x8002] = 0x05;
+	const uint8_t bytes[] = {0x48, 0x8B, 0x05}, mask[] = {0xFF, 0xFF, 0xFF};
+	const MemScanner::MemScanner::Pattern pattern("48 8B 05");
+	auto* first = alloc.data() + 0x100;
+	auto* last = alloc.data() + 0x8000;
+
+	// Disabled by default, every lookup sees the current memory. The search map assumes memory that does not change, so it is off
+	MemScanner::MemScanner scanner;
+	scanner.setSearchMapBudget(0);
+	assert(!scanner.isResultCacheEnabled());
+	assert(scanner.findSignatureInRange<true>("48 8B 05", start, end) == first);
+	alloc[0x100] = 0x90;
+	assert(scanner.findSignatureInRange<true>("48 8B 05", start, end) == last);
+	alloc[0x100] = 0x48;
+
+	scanner.enableResultCache(true);
+	scanner.enableStats(true);
+	assert(scanner.findSignatureInRange<true>("48 8B 05", start, end) == first);
+	assert(scanner.findSignatureInRange<false>(bytes, mask, start, end) == last);
+	assert(scanner.findSignatureInRange<true>(pattern, start, end) == first);
+	assert(scanner.findSignatureInRange<true>(MemScanner::Signature<"48 8B 05">{}, start, end) == first);
+	assert(scanner.findSignatureInRange<true>("01 02 03 04", start, end) == nullptr);
+
+	// Hits do not look at the memory again, including cached misses
+	alloc[0x100] = 0x90, alloc[0x8000] = 0x90;
+	alloc[0x4000] = 0x01, alloc[0x4001] = 0x02, alloc[0x4002] = 0x03, alloc[0x4003] = 0x04;
+	scanner.resetStats();
+	assert(scanner.findSignatureInRange<true>("48 8B 05", start, end) == first);
+	assert(scanner.findSignatureInRange<false>(bytes, mask, start, end) == last);
+	assert(scanner.findSignatureInRange<true>(pattern, start, end) == first);
+	assert(scanner.findSignatureInRange<true>(MemScanner::Signature<"48 8B 05">{}, start, end) == first);
+	assert(scanner.findSignatureInRange<true>("01 02 03 04", start, end) == nullptr);
+	auto stats = scanner.getStats();
+	assert(stats.resultCacheHits == 5 && stats.resultCacheMisses == 0);
+	for (auto scanned : stats.bytesScanned) assert(scanned == 0);
+
+	// Different ranges, directions and disabled caching are separate lookups
+	assert(scanner.findSignatureInRange<true>("48 8B 05", start, end - 1) == nullptr);
+	assert(scanner.findSignatureInRange<false>("48 8B 05", start + 1, end) == nullptr);
+	assert(scanner.findSignatureInRange<true>("48 8B 05", start, end, false) == nullptr);
+	// Text lookups are keyed by their text alone, a miss is counted and stored once
+	scanner.resetStats();
+	assert(scanner.findSignatureInRange<false>("48 8B 05", start, end) == nullptr);
+	stats = scanner.getStats();
+	assert(stats.resultCacheHits == 0 && stats.resultCacheMisses == 1);
+	assert(scanner.findSignatureInRange<false>(bytes, mask, start, end) == last);
+	assert(scanner.getStats().resultCacheHits == 1);
+	// Spans are checked before the cache is probed, the cached text as bytes without a mask is still an invalid pattern
+	const std::string text = "48 8B 05";
+	bool threw = false;
+	try {
+		scanner.findSignatureInRange<false>(std::span<const uint8_t>((const uint8_t*) text.data(), text.size()), {}, start, end);
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	assert(threw);
+
+	// Invalidating a range that does not overlap keeps the results
+	scanner.invalidateResults(end, end + 0x1000);
+	assert(scanner.findSignatureInRange<true>("48 8B 05", start, end) == first);
+	scanner.invalidateResults(start + 0x4000, start + 0x4001);
+	assert(scanner.findSignatureInRange<true>("48 8B 05", start, end) == nullptr);
+	assert(scanner.findSignatureInRange<true>("01 02 03 04", start, end) == alloc.data() + 0x4000);
+	assert(scanner.findSignatureInRange<true>(pattern, start, end) == nullptr);
+
+	// Lookups without allowAddToCache are answered but not stored
+	alloc[0x200] = 0x48, alloc[0x201] = 0x8B, alloc[0x202] = 0x05;
+	scanner.invalidateResults();
+	assert(scanner.findSignatureInRange<true>(pattern, start, end, true, false) == alloc.data() + 0x200);
+	alloc[0x200] = 0x90;
+	assert(scanner.findSignatureInRange<true>(pattern, start, end, true, false) == nullptr);
+
+	// evictCache and disabling drop the results as well
+	alloc[0x300] = 0x48, alloc[0x301] = 0x8B, alloc[0x302] = 0x05;
+	assert(scanner.findSignatureInRange<true>(pattern, start, end) == alloc.data() + 0x300);
+	alloc[0x300] = 0x90;
+	scanner.evictCache();
+	assert(scanner.findSignatureInRange<true>(pattern, start, end) == nullptr);
+	alloc[0x300] = 0x48;
+	scanner.enableResultCache(false);
+	scanner.enableResultCache(true);
+	assert(scanner.findSignatureInRange<true>(pattern, start, end) == alloc.data() + 0x300);
+
+	// The budget evicts older results, the lookups stay correct
+	scanner.setResultCacheBudget(2048);
+	for (int round = 0; round < 2; round++) {
+		for (uintptr_t offset = 0; offset < 200; offset++) assert(scanner.findSignatureInRange<true>(pattern, start + offset, end) == alloc.data() + 0x300);
+		assert(scanner.numCachedResults() > 0 && scanner.numCachedResults() < 40);
+	}
+	scanner.setResultCacheBudget(0);
+	assert(scanner.numCachedResults() == 0);
+	assert(scanner.findSignatureInRange<true>(pattern, start, end) == alloc.data() + 0x300 && scanner.numCachedResults() == 0);
+
+	printf("Result cache tests success!\n");
+}
+
+void testSearchMapBudget() {
+	using SearchMap = MemScanner::MemScanner::ConcurrentSearchMap;
+	auto makeKey = [](uint64_t i) {
+		uint8_t bytes[8], mask[8];
+		memcpy(bytes, &i, sizeof(i));
+		memset(mask, 0xFF, sizeof(mask));
+		return MemScanner::MemScanner::SearchMapKey(bytes, mask, 8);
+	};
+	auto valueOf = [](uint64_t i) { return MemScanner::MemScanner::SearchMapValue(i * 16, i * 16 + 0x100000); };
+	auto checkConsistent = [&](SearchMap& map) {
+		size_t numEntries = 0;
+		map.forEach([&](const MemScanner::MemScanner::SearchMapKey& key, const MemScanner::MemScanner::SearchMapValue& value) {
+			MemScanner::MemScanner::SearchMapValue found;
+			assert(map.find(key, found));  // backward shift deletion keeps every entry reachable
+			assert(found.start == value.start && found.end == value.end);
+			numEntries++;
+		});
+		assert(numEntries == map.size());
+	};
+
+	// The table grows up to the budget without evicting anything
+	SearchMap map;
+	assert(map.getBudget() == SearchMap::defaultBudget && map.maxEntries() >= 5000);
+	for (uint64_t i = 1; i <= 5000; i++) assert(map.insert(makeKey(i), valueOf(i)));
+	for (uint64_t i = 1; i <= 5000; i++) {
+		MemScanner::MemScanner::SearchMapValue value;
+		assert(map.find(makeKey(i), value) && value.start == valueOf(i).start && value.end == valueOf(i).end);
+	}
+	assert(map.size() == 5000 && map.numEvictions() == 0);
+
+	// Shrinking evicts, a key that is hit all the time survives a flood of cold keys
+	map.setBudget(4096);
+	const auto limit = map.maxEntries();
+	assert(limit > 0 && map.size() == limit);
+	checkConsistent(map);
+	const auto hotKey = makeKey(0xDEADBEEF);
+	assert(map.insert(hotKey, valueOf(0xDEADBEEF)));
+	// hits are sampled at random, the hot key is looked up often enough that a sampled hit lands between two clock passes
+	auto hitHotKey = [&](int numLookups) {
+		MemScanner::MemScanner::SearchMapValue value;
+		for (int j = 0; j < numLookups; j++) assert(map.find(hotKey, value));
+	};
+	hitHotKey(256);
+	for (uint64_t i = 10000; i < 10000 + 50 * limit; i++) {
+		hitHotKey(4 * SearchMap::hitSampleInterval);
+		assert(map.insert(makeKey(i), valueOf(i)));
+		assert(map.size() <= limit);
+	}
+	checkConsistent(map);
+	assert(map.numEvictions() > 0);
+
+	// Narrow regions are worth more than wide ones at the same hit count
+	SearchMap narrowMap;
+	narrowMap.setBudget(4096);
+	for (uint64_t i = 0; i < 4 * narrowMap.maxEntries(); i++) narrowMap.insert(makeKey(i), i % 2 ? valueOf(i) : MemScanner::MemScanner::SearchMapValue(5, 5));
+	size_t numNarrow = 0;
+	narrowMap.forEach([&](const MemScanner::MemScanner::SearchMapKey&, const MemScanner::MemScanner::SearchMapValue& value) {
+		numNarrow += value.start == value.end;
+	});
+	assert(numNarrow * 2 > narrowMap.size());
+
+	// Every key of a window is hit, even though the window looks its keys up in a fixed order
+	SearchMap windowMap;
+	const uint8_t windowBytes[8] = {0x48, 0x8B, 0x05, 0x11, 0x22, 0x33, 0x44, 0x55};
+	const uint8_t windowMask[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+	const MemScanner::MemScanner::SearchMapWindow window(windowBytes, windowMask, sizeof(windowBytes));
+	for (unsigned int k = 0; k < window.numKeys; k++) assert(windowMap.insert(window.keys[k], valueOf(k)));
+	for (int round = 0; round < 1000; round++) {
+		for (unsigned int k = 0; k < window.numKeys; k++) {
+			MemScanner::MemScanner::SearchMapValue value;
+			assert(windowMap.find(window.keys[k], value));
+		}
+	}
+	for (unsigned int k = 0; k < window.numKeys; k++) assert(windowMap.numHits(window.keys[k]) > 0);
+	assert(windowMap.numHits(makeKey(1)) == 0);
+
+	map.setBudget(0);
+	assert(map.size() == 0 && !map.insert(hotKey, valueOf(1)));
+
+	// The scanner stays correct with a tiny cache
+	std::default_random_engine generator(197);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	std::vector<unsigned char> alloc(0x10000);
+	for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+	auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+	MemScanner::MemScanner scanner;
+	scanner.setSearchMapBudget(2048);
+	for (int round = 0; round < 2; round++) {
+		for (unsigned int i = 0; i < 64; i++) {
+			char sig[16];
+			snprintf(sig, sizeof(sig), "%02X ?? %02X", i * 3, 0xFF - i);
+			auto [bytes, mask] = MemScanner::MemScanner::ParseSignature(sig);
+			assert(scanner.findSignatureInRange<true>(sig, start, end) == knownGoodPatternSearch(bytes, mask, start, end));
+			while (scanner.doSearchSingleMapKey()) {
+			}
+			assert(scanner.getSearchMap().size() <= scanner.getSearchMap().maxEntries());
+		}
+	}
+	assert(scanner.getSearchMap().numEvictions() > 0);
+	printf("Search map budget tests success!\n");
+}
+
+void testNGramIndex() {
+	std::default_random_engine generator(211);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 7);	 // few distinct 4-grams, so every one of them occurs often
+	std::vector<unsigned char> alloc(0x30000);
+	for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+	auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+
+	MemScanner::MemScanner scanner;
+	scanner.setParallelScanThreads(3);
+	auto index = scanner.buildIndex(start, end);
+	assert(index->covers(start, end) && index->memoryUsage() >= (alloc.size() - 3) * sizeof(uint32_t));
+
+	std::uniform_int_distribution<size_t> offsetDist(0, alloc.size() - 16), lengthDist(1, 14);
+	for (int i = 0; i < 2000; i++) {
+		auto offset = offsetDist(generator);
+		const auto length = lengthDist(generator);
+		std::vector<uint8_t> bytes(alloc.begin() + (ptrdiff_t) offset, alloc.begin() + (ptrdiff_t) (offset + length)), mask(length, 0xFF);
+		for (size_t j = 0; j < length; j++) {
+			if (generator() % 4 == 0) mask[j] = generator() % 2 ? 0 : 0x06;
+			if (i % 3 == 0) bytes[j] = (uint8_t) byteDist(generator);	 // probably no match
+			bytes[j] &= mask[j];
+		}
+		if (mask[0] == 0) mask[0] = 0xFF;
+
+		auto rangeStart = start + offsetDist(generator) / 2, rangeEnd = end - offsetDist(generator) / 2;
+		if (rangeEnd < rangeStart) std::swap(rangeStart, rangeEnd);
+		const MemScanner::MemScanner::Pattern pattern(bytes, mask);
+		auto goodFind = knownGoodPatternSearch(bytes, mask, rangeStart, rangeEnd);
+		auto goodReverseFind = knownGoodPatternSearchReverse(bytes, mask, rangeStart, rangeEnd);
+		assert(scanner.findSignatureInRange<true>(bytes, mask, rangeStart, rangeEnd, false) == goodFind);
+		assert(scanner.findSignatureInRange<false>(bytes, mask, rangeStart, rangeEnd, false) == goodReverseFind);
+		assert(scanner.findSignatureInRange<true>(pattern, rangeStart, rangeEnd) == goodFind);
+		assert(scanner.findSignatureInRange<false>(pattern, rangeStart, rangeEnd) == goodReverseFind);
+	}
+
+	// Ranges outside of the index and tiny indexes fall back to scanning
+	std::vector<unsigned char> other(0x1000, 1);
+	other[0x800] = 7;
+	const std::vector<uint8_t> bytes = {1, 1, 1, 7}, mask(4, 0xFF);
+	assert(scanner.findSignatureInRange<true>(bytes, mask, (uintptr_t) other.data(), (uintptr_t) other.data() + other.size()) == &other[0x7FD]);
+	scanner.buildIndex((uintptr_t) other.data(), (uintptr_t) other.data() + 2);
+	assert(scanner.findSignatureInRange<true>(bytes, mask, (uintptr_t) other.data(), (uintptr_t) other.data() + 2) == nullptr);
+	scanner.dropIndexes();
+	assert(scanner.findSignatureInRange<true>(bytes, mask, start, end) == knownGoodPatternSearch(bytes, mask, start, end));
+	printf("N-gram index tests success!\n");
+}
+
+void testRemoteProcess() {
+#ifdef __linux__
+	std::default_random_engine generator(223);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	std::vector<unsigned char> alloc(0x23456);
+	for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+	const std::vector<uint8_t> marker = {0xDE, 0xC0, 0xAD, 0x0B, 0xFE, 0xED, 0xFA, 0xCE}, mask(marker.size(), 0xFF);
+	// Placed only in the child, at chunk borders and in the overlap of two chunks
+	const std::vector<size_t> offsets = {0x0, 0x1000 - 3, 0x5000 - 8, 0x8001, 0x23456 - 8};
+	// A mapped chunk and page followed by an unmapped page, the marker ends the first chunk
+	const auto pageSize = (size_t) sysconf(_SC_PAGESIZE), edgeChunkSize = (size_t) 1 << 20;
+	auto* edge = (uint8_t*) mmap(nullptr, edgeChunkSize + 2 * pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	assert(edge != MAP_FAILED && munmap(edge + edgeChunkSize + pageSize, pageSize) == 0);
+
+	int toChild[2], toParent[2];
+	assert(pipe(toChild) == 0 && pipe(toParent) == 0);
+	const auto child = fork();
+	assert(child >= 0);
+	if (child == 0) {
+		for (auto offset : offsets) memcpy(&alloc[offset], marker.data(), marker.size());
+		memcpy(edge + edgeChunkSize - marker.size(), marker.data(), marker.size());
+		char c = 0;
+		if (write(toParent[1], &c, 1) != 1) _exit(1);
+		if (read(toChild[0], &c, 1) != 1) _exit(1);	 // wait until the parent is done
+		_exit(0);
+	}
+	char c = 0;
+	assert(read(toParent[0], &c, 1) == 1);
+
+	auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+	for (size_t chunkSize : {(size_t) 0x1000, (size_t) 0x3333, MemScanner::RemoteProcess::defaultChunkSize}) {
+		MemScanner::RemoteProcess process(child, chunkSize);
+		std::vector<uint8_t> copy(16);
+		process.read(start + offsets[1], copy.data(), copy.size());
+		assert(memcmp(copy.data(), marker.data(), marker.size()) == 0);
+
+		assert(process.findSignatureInRange<true>(marker, mask, start, end) == start + offsets.front());
+		assert(process.findSignatureInRange<false>(marker, mask, start, end) == start + offsets.back());
+		assert(process.findSignatureInRange<true>("DE C0 AD 0B FE ED FA CE", start + 1, end - 1) == start + offsets[1]);
+		assert(process.findSignatureInRange<false>("DE C0 AD 0B FE ED FA CE", start + 1, end - 1) == start + offsets[3]);
+		assert(process.findSignatureInRange<true>("DE C0 AD 0B FE ED FA CE", start + 1, start + offsets[1] + 7) == 0);
+
+		std::vector<uintptr_t> matches;
+		assert(process.findAllSignaturesInRange(marker, mask, start, end, matches) == offsets.size());
+		for (size_t i = 0; i < offsets.size(); i++) assert(matches[i] == start + offsets[i]);
+		matches.clear();
+		assert(process.findAllSignaturesInRange(marker, mask, start, end, matches, 2) == 2 && matches[1] == start + offsets[1]);
+
+		// The parent's own copy does not contain the markers
+		std::vector<uint8_t> bytes(alloc.begin() + 0x100, alloc.begin() + 0x110), bytesMask(bytes.size(), 0xFF);
+		assert(process.findSignatureInRange<true>(bytes, bytesMask, start, end) == (uintptr_t) knownGoodPatternSearch(bytes, bytesMask, start, end));
+		assert(knownGoodPatternSearch(marker, mask, start, end) == nullptr);
+
+		bool threw = false;
+		try {
+			process.findSignatureInRange<true>(marker, mask, 0x1000, 0x20000);	// not mapped
+		} catch (const std::runtime_error&) {
+			threw = true;
+		}
+		assert(threw);
+	}
+
+	// The match is in the first chunk, the failed prefetch of the second one that reaches into the unmapped page is not an error
+	const auto edgeStart = (uintptr_t) edge, edgeEnd = edgeStart + edgeChunkSize + pageSize + pageSize / 2;
+	const auto edgeMatch = edgeStart + edgeChunkSize - marker.size();
+	for (int round = 0; round < 10; round++) {
+		MemScanner::RemoteProcess process(child, edgeChunkSize);
+		assert(process.findSignatureInRange<true>(marker, mask, edgeStart, edgeEnd) == edgeMatch);
+		std::vector<uintptr_t> matches;
+		assert(process.findAllSignaturesInRange(marker, mask, edgeStart, edgeEnd, matches, 1) == 1 && matches[0] == edgeMatch);
+		bool threw = false;
+		try {
+			process.findSignatureInRange<true>("CE FA ED FE", edgeStart, edgeEnd);	// has to read the unmapped page
+		} catch (const std::runtime_error&) {
+			threw = true;
+		}
+		assert(threw);
+	}
+
+	// Every position matches, across chunk borders
+	{
+		MemScanner::RemoteProcess process(child, 0x1000);
+		const std::vector<uint8_t> zero = {0x00}, zeroMask = {0xFF};
+		std::vector<uintptr_t> matches;
+		assert(process.findAllSignaturesInRange(zero, zeroMask, edgeStart, edgeStart + 0x3456, matches) == 0x3456);
+		for (size_t i = 0; i < matches.size(); i++) assert(matches[i] == edgeStart + i);
+	}
+
+	assert(write(toChild[1], &c, 1) == 1);
+	int status = 0;
+	assert(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	for (int fd : {toChild[0], toChild[1], toParent[0], toParent[1]}) close(fd);
+	munmap(edge, edgeChunkSize + pageSize);
+	printf("Remote process tests success!\n");
+#endif
+}
+
+void testFileScanner() {
+	std::default_random_engine generator(227);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	std::vector<unsigned char> content(0x52345);
+	for (auto& b : content) b = (unsigned char) byteDist(generator);
+	const std::vector<uint8_t> marker = {0xDE, 0xC0, 0xAD, 0x0B, 0xFE, 0xED, 0xFA, 0xCE}, mask(marker.size(), 0xFF);
+	// at the start, across window borders and at the end
+	const std::vector<size_t> offsets = {0x0, 0x10000 - 3, 0x20000 - 8, 0x30001, content.size() - 8};
+	for (auto offset : offsets) memcpy(&content[offset], marker.data(), marker.size());
+
+	auto path = fs::temp_directory_path() / "MemScannerTest.bin";
+	{
+		std::ofstream out(path, std::ios::binary);
+		out.write((const char*) content.data(), (std::streamsize) content.size());
+	}
+	auto start = (uintptr_t) content.data(), end = start + content.size();
+	auto toOffset = [&](void* match) { return match == nullptr ? MemScanner::FileScanner::notFound : (uint64_t) ((uintptr_t) match - start); };
+
+	for (size_t windowSize : {(size_t) 0x10000, MemScanner::FileScanner::defaultWindowSize}) {
+		MemScanner::FileScanner file(path, windowSize);
+		assert(file.size() == content.size());
+		assert((file.data() != nullptr) == (windowSize >= content.size()));
+
+		assert(file.findSignature<true>(marker, mask) == offsets.front());
+		assert(file.findSignature<false>(marker, mask) == offsets.back());
+		assert(file.findSignature<true>("CE ?? ?? ?? FF FF FF FF FF FF") == MemScanner::FileScanner::notFound);
+
+		std::vector<uint64_t> found;
+		assert(file.findAllSignatures(marker, mask, found) == offsets.size());
+		for (size_t i = 0; i < offsets.size(); i++) assert(found[i] == offsets[i]);
+		found.clear();
+		assert(file.findAllSignatures(marker, mask, found, 3) == 3 && found[2] == offsets[2]);
+
+		std::uniform_int_distribution<size_t> offsetDist(0, content.size() - 16);
+		std::vector<MemScanner::MemScanner::ParsedSignature> patterns;
+		for (int i = 0; i < 40; i++) {
+			auto offset = offsetDist(generator);
+			const auto length = (ptrdiff_t) (2 + i % 10);
+			std::vector<uint8_t> bytes(content.begin() + (ptrdiff_t) offset, content.begin() + (ptrdiff_t) offset + length), patternMask(bytes.size(), 0xFF);
+			if (i % 3 == 0) bytes[1] = patternMask[1] = 0;
+			assert(file.findSignature<true>(bytes, patternMask) == toOffset(knownGoodPatternSearch(bytes, patternMask, start, end)));
+			assert(file.findSignature<false>(bytes, patternMask) == toOffset(knownGoodPatternSearchReverse(bytes, patternMask, start, end)));
+			patterns.emplace_back(std::move(bytes), std::move(patternMask));
+		}
+		patterns.push_back(MemScanner::MemScanner::ParseSignature("CE ?? ?? ?? FF FF FF FF FF FF"));
+		auto batch = file.findSignatures(std::span<const MemScanner::MemScanner::ParsedSignature>(patterns));
+		for (size_t i = 0; i < patterns.size(); i++) assert(batch[i] == toOffset(knownGoodPatternSearch(patterns[i].first, patterns[i].second, start, end)));
+	}
+
+	// Empty files have no matches
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	}
+	MemScanner::FileScanner empty(path);
+	assert(empty.size() == 0 && empty.findSignature<true>(marker, mask) == MemScanner::FileScanner::notFound);
+
+	fs::remove(path);
+	printf("File scanner tests success!\n");
+}
+
+void testStreamScanner() {
+	std::default_random_engine generator(239);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 3);	 // few distinct values so short patterns match often
+	std::vector<unsigned char> content(0x30000);
+	for (auto& b : content) b = (unsigned char) byteDist(generator);
+	auto start = (uintptr_t) content.data(), end = start + content.size();
+
+	auto allMatches = [&](const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask) {
+		std::vector<uint64_t> expected;
+		for (auto cur = start; cur + bytes.size() <= end;) {
+			auto* match = knownGoodPatternSearch(bytes, mask, cur, end);
+			if (match == nullptr) break;
+			expected.push_back((uint64_t) ((uintptr_t) match - start));
+			cur = (uintptr_t) match + 1;
+		}
+		return expected;
+	};
+
+	std::uniform_int_distribution<size_t> offsetDist(0, content.size() - 64), chunkDist(0, 200);
+	for (int i = 0; i < 24; i++) {
+		const auto offset = (ptrdiff_t) offsetDist(generator);
+		const auto length = (ptrdiff_t) (1 + i % 12 + (i % 4 == 3 ? 40 : 0));
+		std::vector<uint8_t> bytes(content.begin() + offset, content.begin() + offset + length), mask(bytes.size(), 0xFF);
+		if (i % 3 == 0 && bytes.size() > 2) bytes[1] = mask[1] = 0;
+		const auto expected = allMatches(bytes, mask);
+
+		// Chunks from empty over smaller than the pattern to larger than the kernel block size
+		MemScanner::StreamScanner stream(bytes, mask);
+		std::vector<uint64_t> found;
+		for (size_t pos = 0; pos < content.size();) {
+			auto size = std::min(content.size() - pos, i % 2 == 0 ? chunkDist(generator) : chunkDist(generator) * 64);
+			stream.feed(std::span<const uint8_t>(content.data() + pos, size), found);
+			pos += size;
+		}
+		assert(stream.bytesFed() == content.size());
+		assert(found == expected);
+
+		// One byte at a time, every match comes from the carried bytes
+		if (i < 6) {
+			stream.reset();
+			found.clear();
+			for (auto b : content) stream.feed(std::span<const uint8_t>(&b, 1), found);
+			assert(found == expected);
+		}
+	}
+
+	// maxMatches only limits the current chunk
+	MemScanner::StreamScanner stream("01 02 03");
+	const std::vector<uint8_t> first = {1, 2, 3, 1, 2, 3, 1, 2}, second = {3, 0, 1, 2, 3};
+	std::vector<uint64_t> found;
+	assert(stream.feed(first, found, 1) == 1 && found.size() == 1 && found[0] == 0);
+	assert(stream.feed(second, found) == 2 && found.size() == 3 && found[1] == 6 && found[2] == 10);
+	printf("Stream scanner tests success!\n");
+}
+
+void testScanStats() {
+	std::default_random_engine generator(251);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	std::vector<unsigned char> alloc(0x20000);
+	for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+	const std::vector<uint8_t> marker = {0xDE, 0xC0, 0xAD, 0x0B, 0xFE, 0xED}, mask(marker.size(), 0xFF);
+	memcpy(&alloc[0x10000], marker.data(), marker.size());
+	auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+	auto totalBytes = [](const MemScanner::MemScanner::ScanStats& stats) {
+		uint64_t sum = 0;
+		for (auto bytes : stats.bytesScanned) sum += bytes;
+		return sum;
+	};
+
+	// Off by default
+	MemScanner::MemScanner scanner;
+	assert(!scanner.areStatsEnabled());
+	assert(scanner.findSignatureInRange<true>(marker, mask, start, end) == &alloc[0x10000]);
+	auto stats = scanner.getStats();
+	assert(totalBytes(stats) == 0 && stats.candidates == 0 && stats.searchMapMisses == 0 && stats.pendingSearches > 0);
+	while (scanner.doSearchSingleMapKey()) continue;
+	scanner.evictCache();
+
+	scanner.enableStats(true);
+	assert(scanner.findSignatureInRange<true>(marker, mask, start, end, false, false) == &alloc[0x10000]);
+	stats = scanner.getStats();
+	assert(totalBytes(stats) >= 0x10000 && totalBytes(stats) < alloc.size() && stats.verifiedMatches == 1 && stats.candidates >= 1);
+	assert(stats.narrowedScans == 0 && stats.searchMapHits == 0 && stats.searchMapMisses == 0);
+
+	// Misses queue the keys, the background searches fill the map and the next scan is narrowed down to the match
+	scanner.resetStats();
+	assert(scanner.findSignatureInRange<true>(marker, mask, start, end) == &alloc[0x10000]);
+	stats = scanner.getStats();
+	const auto numQueued = stats.pendingSearches;
+	assert(numQueued > 0 && stats.searchMapMisses >= numQueued && stats.searchMapHits == 0);
+	assert(stats.narrowedScans == 1 && stats.bytesRequested == alloc.size() && stats.bytesAfterNarrowing == alloc.size());
+	while (scanner.doSearchSingleMapKey()) continue;
+	stats = scanner.getStats();
+	assert(stats.sigRunnerJobs == numQueued && stats.sigRunnerBytes >= 0x10000 && stats.pendingSearches == 0);
+	assert(scanner.findSignatureInRange<true>(marker, mask, start, end) == &alloc[0x10000]);
+	stats = scanner.getStats();
+	assert(stats.searchMapHits > 0 && stats.narrowedScans == 2 && stats.bytesAfterNarrowing - alloc.size() <= 0x10000);
+
+	// Every thread counts separately, getStats adds them up. Scans without a match test every start position exactly once
+	const std::vector<uint8_t> impossible = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12}, fullMask(impossible.size(), 0xFF);
+	scanner.resetStats();
+	assert(totalBytes(scanner.getStats()) == 0);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([&, i] {
+			for (int j = 0; j < 10; j++) {
+				void* match = i % 2 ? scanner.findSignatureInRange<true>(impossible, fullMask, start, end, false, false)
+									: scanner.findSignatureInRange<false>(impossible, fullMask, start, end, false, false);
+				assert(match == nullptr);
+			}
+		});
+	}
+	for (auto& thread : threads) thread.join();
+	stats = scanner.getStats();
+	assert(totalBytes(stats) == 40 * (alloc.size() - impossible.size() + 1) && stats.verifiedMatches == 0);
+
+	// Multi pattern scans count separately
+	scanner.resetStats();
+	const std::vector<const char*> signatures = {"DE C0 AD 0B", "01 02 03 04 05 06 07 08"};
+	auto results = scanner.findSignaturesInRange(std::span<const char* const>(signatures), start, end);
+	assert(results[0] == &alloc[0x10000] && results[1] == nullptr);
+	stats = scanner.getStats();
+	assert(stats.bytesScanned[MemScanner::MemScanner::ScanStats::MultiFast1] + stats.bytesScanned[MemScanner::MemScanner::ScanStats::MultiAVX2] > 0);
+	assert(stats.verifiedMatches == 1);
+
+	scanner.enableStats(false);
+	scanner.resetStats();
+	assert(scanner.findSignatureInRange<true>(marker, mask, start, end, false, false) == &alloc[0x10000]);
+	assert(totalBytes(scanner.getStats()) == 0);
+	printf("Scan stats tests success!\n");
+}
+
+struct DetachedCoroutine {
+	struct promise_type {
+		DetachedCoroutine get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+DetachedCoroutine awaitSignatures(MemScanner::MemScanner& scanner, uintptr_t start, uintptr_t end, std::promise<std::pair<void*, void*>>& out) {
+	void* first = co_await scanner.findSignatureInRangeAsync<true>("DE C0 AD 0B", start, end);
+	void* last = co_await scanner.findSignatureInRangeAsync<false>("DE C0 AD 0B", start, end);
+	out.set_value({first, last});
+}
+
+void testAsyncSignatures() {
+	std::default_random_engine generator(263);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	std::vector<unsigned char> alloc(0x40000);
+	for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+	const std::vector<uint8_t> marker = {0xDE, 0xC0, 0xAD, 0x0B}, mask(marker.size(), 0xFF);
+	memcpy(&alloc[0x1000], marker.data(), marker.size());
+	memcpy(&alloc[0x30000], marker.data(), marker.size());
+	auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+
+	// Without sig runner threads the lookup runs on the calling thread, the caller still chooses the number of workers afterwards
+	MemScanner::MemScanner scanner;
+	auto inlineLookup = scanner.findSignatureInRangeAsync<true>(marker, mask, start, end);
+	assert(inlineLookup.ready() && inlineLookup.get() == &alloc[0x1000]);
+	scanner.startSigRunnerThread(4);
+
+	// Every lookup is issued up front and compared with the synchronous result
+	std::vector<std::vector<uint8_t>> patterns;
+	std::vector<MemScanner::MemScanner::AsyncSignature> lookups;
+	std::uniform_int_distribution<size_t> offsetDist(0, alloc.size() - 16);
+	for (int i = 0; i < 32; i++) {
+		const auto offset = (ptrdiff_t) offsetDist(generator);
+		patterns.emplace_back(alloc.begin() + offset, alloc.begin() + offset + 3 + i % 6);
+		const std::vector<uint8_t> fullMask(patterns.back().size(), 0xFF);
+		lookups.push_back(i % 2 ? scanner.findSignatureInRangeAsync<true>(patterns.back(), fullMask, start, end)
+								: scanner.findSignatureInRangeAsync<false>(patterns.back(), fullMask, start, end, false));
+	}
+	for (size_t i = 0; i < lookups.size(); i++) {
+		const std::vector<uint8_t> fullMask(patterns[i].size(), 0xFF);
+		auto* expected = i % 2 ? knownGoodPatternSearch(patterns[i], fullMask, start, end) : knownGoodPatternSearchReverse(patterns[i], fullMask, start, end);
+		assert(lookups[i].get() == expected && lookups[i].ready());
+	}
+
+	// Callbacks and coroutines continue without polling
+	std::promise<void*> callbackResult;
+	scanner.findSignatureInRangeAsync<true>(marker, mask, start, end).then([&](const auto& lookup) { callbackResult.set_value(lookup.get()); });
+	assert(callbackResult.get_future().get() == &alloc[0x1000]);
+	std::promise<std::pair<void*, void*>> coroutineResult;
+	awaitSignatures(scanner, start, end, coroutineResult);
+	assert(coroutineResult.get_future().get() == std::make_pair((void*) &alloc[0x1000], (void*) &alloc[0x30000]));
+
+	// Identical requests share one lookup while it is queued. The only worker is held up by a callback until they are issued
+	scanner.stopSigRunnerThread();
+	scanner.startSigRunnerThread(1);
+	const auto testThread = std::this_thread::get_id();
+	std::promise<void> release;
+	auto released = release.get_future().share();
+	std::atomic<bool> blocked = false;
+	for (uintptr_t blockerEnd = end; !blocked; blockerEnd--) {
+		std::atomic<bool> ranInline = false;
+		scanner.findSignatureInRangeAsync<true>(marker, mask, start + 0x2000, blockerEnd, false).then([&](const auto&) {
+			if (std::this_thread::get_id() == testThread) {
+				ranInline = true;
+				return;
+			}
+			blocked = true;
+			released.wait();
+		});
+		while (!ranInline && !blocked) std::this_thread::yield();
+	}
+	auto first = scanner.findSignatureInRangeAsync<false>("DE C0 AD 0B", start, end);
+	auto second = scanner.findSignatureInRangeAsync<false>(marker, mask, start, end);
+	auto other = scanner.findSignatureInRangeAsync<true>(marker, mask, start, end);
+	assert(first == second && !(first == other) && !first.ready());
+	release.set_value();
+	assert(first.get() == &alloc[0x30000] && second.get() == &alloc[0x30000] && other.get() == &alloc[0x1000]);
+
+	// Invalid patterns fail right away
+	bool threw = false;
+	try {
+		scanner.findSignatureInRangeAsync<true>(std::vector<uint8_t>{0x00}, std::vector<uint8_t>{0x00}, start, end);
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	assert(threw);
+	scanner.stopSigRunnerThread();
+	printf("Async signature tests success!\n");
+}
+
+void testProcessScan() {
+	std::default_random_engine generator(271);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 3);	 // few distinct values so the pattern matches often
+	std::vector<unsigned char> content(0x90000);
+	for (auto& b : content) b = (unsigned char) byteDist(generator);
+	auto start = (uintptr_t) content.data();
+
+	// Unordered ranges with matches across chunk borders, compared with one scan per range
+	MemScanner::MemScanner scanner;
+	const std::vector<uint8_t> bytes = {1, 0, 2, 3, 3}, mask = {0xFF, 0x00, 0xFF, 0xFF, 0xFF};
+	const std::vector<std::pair<uintptr_t, uintptr_t>> ranges = {
+		{start + 0x50000, start + 0x90000}, {start + 0x100, start + 0x103}, {start, start + 0x100}, {start + 0x200, start + 0x4A123}};
+	std::vector<void*> expected;
+	for (const auto& [rangeStart, rangeEnd] : {ranges[2], ranges[1], ranges[3], ranges[0]}) {
+		for (auto cur = rangeStart; cur + bytes.size() <= rangeEnd;) {
+			auto* match = knownGoodPatternSearch(bytes, mask, cur, rangeEnd);
+			if (match == nullptr) break;
+			expected.push_back(match);
+			cur = (uintptr_t) match + 1;
+		}
+	}
+	assert(expected.size() > 100);
+	std::vector<void*> found;
+	assert(scanner.findAllSignaturesInRangesParallel(bytes, mask, ranges, found) == expected.size() && found == expected);
+	found.clear();
+	assert(scanner.findAllSignaturesInRangesParallel(bytes, mask, ranges, found, 7) == 7);
+	assert(std::equal(found.begin(), found.end(), expected.begin()));
+
+	// The mappings of the process are sorted, readable and cover the heap and the code
+	const auto regions = MemScanner::Mem::GetMemoryRegions();
+	auto contains = [](const MemScanner::MemoryRegion& region, const void* address) {
+		return region.start <= (uintptr_t) address && (uintptr_t) address < region.end;
+	};
+	auto* code = (const uint8_t*) &knownGoodPatternSearch;
+	assert(std::is_sorted(regions.begin(), regions.end(), [](const auto& a, const auto& b) { return a.start < b.start; }));
+	assert(std::any_of(regions.begin(), regions.end(), [&](const auto& region) { return contains(region, content.data()) && region.writable; }));
+	assert(std::any_of(regions.begin(), regions.end(), [&](const auto& region) { return contains(region, code) && region.executable; }));
+
+	// A marker on the heap is found in anonymous memory (so is the pattern itself) and not in the mapped files
+	std::uniform_int_distribution<unsigned int> markerDist(0, 0xFF);
+	std::vector<uint8_t> marker(24);
+	for (auto& b : marker) b = (unsigned char) markerDist(generator);
+	const std::vector<uint8_t> markerMask(marker.size(), 0xFF);
+	memcpy(&content[0x1234], marker.data(), marker.size());
+	MemScanner::Mem mem;
+	MemScanner::RegionFilter anonymous;
+	anonymous.backing = MemScanner::RegionFilter::Backing::Anonymous;
+	anonymous.writable = true;
+	auto result = mem.findAllSignaturesInProcess(marker, markerMask, anonymous);
+	assert(result.matches.size() >= 2);
+	auto isMarker = [&](const MemScanner::RegionMatch& match) { return match.address == &content[0x1234]; };
+	auto it = std::find_if(result.matches.begin(), result.matches.end(), isMarker);
+	assert(it != result.matches.end() && contains(result.regions[it->region], content.data()));
+	for (const auto& match : result.matches) {
+		const auto& region = result.regions[match.region];
+		assert(contains(region, match.address) && region.writable && !region.isFileBacked());
+	}
+	MemScanner::RegionFilter fileCode;
+	fileCode.backing = MemScanner::RegionFilter::Backing::File;
+	fileCode.executable = true;
+	assert(mem.findAllSignaturesInProcess(marker, markerMask, fileCode).matches.empty());
+
+	// Code of this executable is attributed to its file mapping
+	std::vector<uint8_t> codeBytes(code, code + 16);
+	result = mem.findAllSignaturesInProcess(codeBytes, std::vector<uint8_t>(codeBytes.size(), 0xFF), fileCode);
+	it = std::find_if(result.matches.begin(), result.matches.end(), [&](const auto& match) { return match.address == code; });
+	assert(it != result.matches.end() && result.regions[it->region].isFileBacked() && result.regions[it->region].executable);
+	for (const auto& region : result.regions) assert(region.executable && region.isFileBacked());
+	fileCode.pathContains = result.regions[it->region].path;
+	assert(!mem.GetMemoryRegions(fileCode).empty());
+	fileCode.pathContains = "no such file";
+	assert(mem.GetMemoryRegions(fileCode).empty());
+
+	// maxMatches keeps the lowest matches
+	result = mem.findAllSignaturesInProcess(marker, markerMask, {}, 1);
+	assert(result.matches.size() == 1 && contains(result.regions[result.matches[0].region], result.matches[0].address));
+
+#ifdef __linux__
+	// A file mapping that reaches past the end of the file only covers the pages the file has, scanning it does not raise SIGBUS
+	auto path = fs::temp_directory_path() / "MemScannerTest.short";
+	{
+		std::ofstream out(path, std::ios::binary);
+		out.write((const char*) marker.data(), (std::streamsize) marker.size());
+	}
+	const auto pageSize = (size_t) sysconf(_SC_PAGESIZE);
+	const int fd = open(path.c_str(), O_RDONLY);
+	assert(fd >= 0);
+	auto* mapping = (uint8_t*) mmap(nullptr, 4 * pageSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	assert(mapping != MAP_FAILED);
+	close(fd);
+	MemScanner::RegionFilter shortFile;
+	shortFile.pathContains = path.string();
+	const auto shortRegions = mem.GetMemoryRegions(shortFile);
+	assert(shortRegions.size() == 1 && shortRegions[0].start == (uintptr_t) mapping && shortRegions[0].end == (uintptr_t) mapping + pageSize);
+	result = mem.findAllSignaturesInProcess(marker, markerMask, shortFile);
+	assert(result.matches.size() == 1 && result.matches[0].address == mapping);
+	munmap(mapping, 4 * pageSize);
+	fs::remove(path);
+#endif
+	printf("Process scan tests success!\n");
+}
+
+void testSigRunner() {
+	std::default_random_engine generator(173);	// predictable seed
+	std::uniform_int_distribution<unsigned int> byteDist(0, 0xFF);
+	std::vector<unsigned char> alloc(0x40000);
+	for (auto& b : alloc) b = (unsigned char) byteDist(generator);
+	const std::vector<const char*> signatures = {"48 8B 05", "E8 ?? ?? ?? ?? 90", "4? 8B C?", "01 02 03 04 05", "FF 15", "90 90"};
+	auto start = (uintptr_t) alloc.data(), end = start + alloc.size();
+
+	auto waitForRunners = [](MemScanner::MemScanner& scanner) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+		while (scanner.numPendingSearches() > 0) {
+			assert(std::chrono::steady_clock::now() < deadline);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	};
+
+	MemScanner::MemScanner scanner;
+	scanner.startSigRunnerThread(3);
+	for (int round = 0; round < 3; round++) {
+		for (auto* sig : signatures) {
+			auto [bytes, mask] = MemScanner::MemScanner::ParseSignature(sig);
+			assert(scanner.findSignatureInRange<true>(sig, start, end) == knownGoodPatternSearch(bytes, mask, start, end));
+		}
+		waitForRunners(scanner);
+		for (auto* sig : signatures) {
+			auto [bytes, mask] = MemScanner::MemScanner::ParseSignature(sig);
+			assert(scanner.findSignatureInRange<true>(sig, start, end, true, false) == knownGoodPatternSearch(bytes, mask, start, end));
+		}
+
+		// Evicting while the runners are busy must not leave stale entries behind
+		for (auto* sig : signatures) scanner.findSignatureInRange<false>(sig, start, end);
+		scanner.evictCache();
+		waitForRunners(scanner);
+
+		scanner.stopSigRunnerThread();
+		scanner.startSigRunnerThread(round + 1);
+	}
+
+	bool threw = false;
+	try {
+		scanner.startSigRunnerThread();
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	assert(threw);
+
+	// A start racing with a stop must neither keep the stopped workers alive nor hang the stop
+	for (int round = 0; round < 50; round++) {
+		std::thread stopper([&] { scanner.stopSigRunnerThread(); });
+		try {
+			scanner.startSigRunnerThread(2);
+		} catch (const std::runtime_error&) {
+		}
+		stopper.join();
+	}
+	scanner.stopSigRunnerThread();
+	printf("Sig runner tests success!\n");
+}
+
 void testSelf() {
-#ifdef _WIN32
 	MemScanner::Mem mem{};
-	auto exeHandle = (void*) GetModuleHandleA(nullptr);
-	auto textSection = MemScanner::Mem::GetSectionRange(exeHandle, ".text");
+	auto textSection = MemScanner::Mem::GetSectionRange(MemScanner::Mem::FindModule(nullptr), ".text");
 	auto allocSize = textSection.second - textSection.first;
 	auto* alloc = (unsigned char*) textSection.first;
-	printf("Self test size: %lld (%llX)\n", allocSize, allocSize);
+	printf("Self test size: %llu (%llX)\n", (unsigned long long) allocSize, (unsigned long long) allocSize);
 
 	benchmarkBuffer(mem.getScanner(), allocSize, alloc, ".exe");
-#else
-	printf("Self test is only implemented on windows!");
+}
+
+void testModuleResolution() {
+	MemScanner::Mem mem{};
+	auto* self = MemScanner::Mem::FindModule(nullptr);
+	assert(self != nullptr);
+	auto text = MemScanner::Mem::GetSectionRange(self, ".text");
+	auto ownCode = reinterpret_cast<uintptr_t>(&testModuleResolution);
+	assert(text.first < text.second && ownCode >= text.first && ownCode < text.second);
+	assert(MemScanner::Mem::GetSectionRange(self, ".text") == text);  // cached
+
+	bool threw = false;
+	try {
+		MemScanner::Mem::GetSectionRange(self, ".doesnotexist");
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	assert(threw);
+
+	// The code of this function is found within the .text section of the executable
+	std::vector<uint8_t> bytes((uint8_t*) ownCode, (uint8_t*) ownCode + 24), mask(24, 0xFF);
+	auto* found = (uint8_t*) mem.findSignature<true>(bytes, mask, false);
+	assert(found != nullptr && (uintptr_t) found >= text.first && (uintptr_t) found <= ownCode && memcmp(found, bytes.data(), bytes.size()) == 0);
+	assert(mem.findSignature<false>(bytes, mask, false) >= (void*) ownCode);
+
+#ifndef _WIN32
+	// Any address within a shared object resolves to that object
+	auto libcText = MemScanner::Mem::GetSectionRange((void*) &strlen, ".text");
+	assert(reinterpret_cast<uintptr_t>(&strlen) >= libcText.first && reinterpret_cast<uintptr_t>(&strlen) < libcText.second);
+	assert(MemScanner::Mem::FindModule("libc") != nullptr && MemScanner::Mem::FindModule("doesnotexist") == nullptr);
+	// Whole file names only, up to the version suffix
+	auto* libc = MemScanner::Mem::FindModule("libc.so.6");
+	assert(libc != nullptr && MemScanner::Mem::FindModule("libc") == libc && MemScanner::Mem::FindModule("libc.so") == libc);
+	assert(MemScanner::Mem::GetSectionRange(libc, ".text") == libcText);
+	assert(MemScanner::Mem::FindModule("libstdc++") != nullptr && MemScanner::Mem::FindModule("libstdc") == nullptr);
+	assert(MemScanner::Mem::FindModule("libc.so.6") == libc);  // cached
 #endif
+	printf("Module resolution tests success!\n");
 }
 
 void testSecondary(const fs::path& path) {
 	assert(fs::exists(path));
 	assert(fs::is_regular_file(path));
 
-	std::basic_fstream<unsigned char> inStream(path);
-	if (!inStream.good()) throw std::runtime_error("could not open infile");
-	auto file_size = fs::file_size(path);
-	auto buffer = std::make_unique<unsigned char[]>(file_size);
-	inStream.read(buffer.get(), (std::streamsize) file_size);
-	inStream.close();
-
-	MemScanner::MemScanner scanner{};
-	benchmarkBuffer(scanner, file_size, buffer.get(), "secondary exe");
+	MemScanner::FileScanner file(path);
+	if (file.data() == nullptr) throw std::runtime_error("file is too large to be mapped at once");
+	benchmarkBuffer(file.getScanner(), file.size(), const_cast<unsigned char*>(file.data()), "secondary exe");
 }
 
 int main(int argc, char* argv[]) {
 	printf("AVX: %s\n", MemScanner::MemScanner::hasFullAVXSupport() ? "enabled" : "unsupported");
+	printf("SSE4.2: %s\n", MemScanner::MemScanner::hasSSE42Support() ? "enabled" : "unsupported");
 
 	bool enableBenchmark = true;
 	if (argc >= 2) {
@@ -411,11 +1938,36 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
+	testBatchSearch();
+	testFindAll();
+	testParallelSearch();
+	testCompileTimeSignatures();
+	testMaskedSignatures();
+	testCandidateVerification();
+	testShortPatterns();
+	testSearchMapPersistence();
+	testSigRunner();
+	testResultCache();
+	testSearchMapBudget();
+	testNGramIndex();
+	testModuleResolution();
+	testRemoteProcess();
+	testFileScanner();
+	testStreamScanner();
+	testScanStats();
+	testAsyncSignatures();
+	testProcessScan();
 	testRandomSyntheticBufferSize<false>();
 	if (!enableBenchmark) testRandomSyntheticBufferSize<true>();  // test with cache enabled
 
 	testSyntheticBufferSize(enableBenchmark);
-	if (enableBenchmark) testSelf();
+	if (enableBenchmark) {
+		printf("Benchmarking call overhead...\n");
+		benchmarkCallOverhead();
+		printf("Benchmarking cached lookups...\n");
+		benchmarkCacheHits();
+		testSelf();
+	}
 	// testSecondary(fs::path("/"));
 
 	return 0;